@@ -0,0 +1,520 @@
+/*
+  Shared micro-benchmark harness for scheduler_bench, ride_share_bench and
+  stats_bench. Header-only and usable from C and C++.
+
+  A benchmark body runs 'warmup' times untimed, then 'reps' times timed; each
+  timed run is one sample of ns per operation, reported as min / p50 / p90 /
+  p99 / mean. Around the timed runs the harness reads hardware counters
+  (cycles, instructions, cache misses) through perf_event_open where the
+  kernel allows it, and an optional allocation counter supplied by the
+  caller. Results print as a table and/or as JSON lines (one object per
+  benchmark, fixed key order) that can be diffed across commits or used as
+  the baseline of a regression gate. Dataset generators are seeded and use
+  their own PRNG, so a given seed yields the same data everywhere.
+
+  Common options, parsed by bench_session_option():
+    --reps N --warmup N --seed N --no-perf
+    --json FILE        (also --save-baseline FILE; "-" is stdout, which turns the table off)
+    --gate FILE        compare against a JSON-lines baseline; exit 2 on regression
+                       or when a baseline bench did not run (new benches are listed)
+    --tolerance X      allowed p50 slowdown before a benchmark counts as regressed (0.25)
+*/
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* ---------- Clock and sink ---------- */
+
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* Keeps a computed value alive so the optimizer cannot drop the loop producing it. */
+static volatile double bench_sink;
+
+static inline void bench_consume(double v) { bench_sink = v; }
+
+/* ---------- Seeded generators ---------- */
+
+/* splitmix64: tiny, fast, and the same sequence on every platform. */
+typedef struct {
+    uint64_t state;
+} bench_rng;
+
+static inline bench_rng bench_rng_make(uint64_t seed) {
+    bench_rng r;
+    r.state = seed;
+    return r;
+}
+
+static inline uint64_t bench_rng_next(bench_rng *r) {
+    uint64_t z = (r->state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/* Uniform in [0, n); the modulo bias is below 2^-40 for any n a benchmark uses. */
+static inline uint64_t bench_rng_below(bench_rng *r, uint64_t n) {
+    return bench_rng_next(r) % n;
+}
+
+/* Uniform in [0, 1) with 53 random bits. */
+static inline double bench_rng_unit(bench_rng *r) {
+    return (double)(bench_rng_next(r) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Standard normal (Box-Muller, one value per call). */
+static inline double bench_rng_normal(bench_rng *r) {
+    const double u = 1.0 - bench_rng_unit(r), v = bench_rng_unit(r);
+    return sqrt(-2.0 * log(u)) * cos(6.283185307179586 * v);
+}
+
+static inline void bench_gen_uniform_i32(int *a, size_t n, int lo, int hi, uint64_t seed) {
+    bench_rng r = bench_rng_make(seed);
+    const uint64_t span = (uint64_t)((int64_t)hi - lo) + 1;
+    for (size_t i = 0; i < n; ++i) a[i] = (int)((int64_t)lo + (int64_t)bench_rng_below(&r, span));
+}
+
+/*
+  Zipf-like ints: value v in [0, distinct) with probability proportional to
+  1 / (v + 1)^skew, drawn by binary search over the cumulative weights. A
+  few heavy values and a long tail, like real categorical data.
+*/
+static inline int bench_gen_zipf_i32(int *a, size_t n, size_t distinct, double skew, uint64_t seed) {
+    double *cdf = (double *)malloc((distinct ? distinct : 1) * sizeof(double));
+    if (!cdf) return 0;
+    double total = 0.0;
+    for (size_t v = 0; v < distinct; ++v) cdf[v] = total += 1.0 / pow((double)(v + 1), skew);
+    bench_rng r = bench_rng_make(seed);
+    for (size_t i = 0; i < n; ++i) {
+        const double x = bench_rng_unit(&r) * total;
+        size_t lo = 0, hi = distinct - 1;
+        while (lo < hi) {
+            const size_t mid = lo + (hi - lo) / 2;
+            if (cdf[mid] <= x) lo = mid + 1;
+            else hi = mid;
+        }
+        a[i] = (int)lo;
+    }
+    free(cdf);
+    return 1;
+}
+
+/* Latency-like int64s: lognormal around 'median' (e.g. nanoseconds) with log-space spread 'sigma'. */
+static inline void bench_gen_lognormal_i64(int64_t *a, size_t n, double median, double sigma, uint64_t seed) {
+    bench_rng r = bench_rng_make(seed);
+    for (size_t i = 0; i < n; ++i) a[i] = (int64_t)llround(median * exp(sigma * bench_rng_normal(&r)));
+}
+
+static inline void bench_gen_uniform_f64(double *a, size_t n, double lo, double hi, uint64_t seed) {
+    bench_rng r = bench_rng_make(seed);
+    for (size_t i = 0; i < n; ++i) a[i] = lo + (hi - lo) * bench_rng_unit(&r);
+}
+
+/* ---------- Hardware counters ---------- */
+
+enum { BENCH_CYCLES, BENCH_INSTRUCTIONS, BENCH_CACHE_MISSES, BENCH_COUNTERS };
+
+static const char *const bench_counter_names[BENCH_COUNTERS] = {"cycles", "instructions", "cache_misses"};
+
+/* One per-thread counter per event; an fd of -1 is an event the kernel refused. */
+typedef struct {
+    int fd[BENCH_COUNTERS];
+} bench_perf;
+
+static inline void bench_perf_open(bench_perf *p, int enabled) {
+    for (int c = 0; c < BENCH_COUNTERS; ++c) p->fd[c] = -1;
+#if defined(__linux__)
+    if (!enabled) return;
+    static const uint64_t config[BENCH_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+    for (int c = 0; c < BENCH_COUNTERS; ++c) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof attr;
+        attr.config = config[c];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        p->fd[c] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#else
+    (void)enabled;
+#endif
+}
+
+static inline void bench_perf_close(bench_perf *p) {
+#if defined(__linux__)
+    for (int c = 0; c < BENCH_COUNTERS; ++c) if (p->fd[c] >= 0) close(p->fd[c]);
+#endif
+    for (int c = 0; c < BENCH_COUNTERS; ++c) p->fd[c] = -1;
+}
+
+static inline void bench_perf_start(bench_perf *p) {
+#if defined(__linux__)
+    for (int c = 0; c < BENCH_COUNTERS; ++c) {
+        if (p->fd[c] < 0) continue;
+        ioctl(p->fd[c], PERF_EVENT_IOC_RESET, 0);
+        ioctl(p->fd[c], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#else
+    (void)p;
+#endif
+}
+
+/* Counts since bench_perf_start(); -1 for an unavailable event. */
+static inline void bench_perf_stop(bench_perf *p, long long out[BENCH_COUNTERS]) {
+    for (int c = 0; c < BENCH_COUNTERS; ++c) {
+        out[c] = -1;
+#if defined(__linux__)
+        if (p->fd[c] < 0) continue;
+        ioctl(p->fd[c], PERF_EVENT_IOC_DISABLE, 0);
+        long long count = 0;
+        if (read(p->fd[c], &count, sizeof count) == (ssize_t)sizeof count) out[c] = count;
+#endif
+    }
+}
+
+/* ---------- Runner ---------- */
+
+typedef struct {
+    int warmup;                  /* untimed runs before sampling */
+    int reps;                    /* timed runs, one sample each */
+    int perf;                    /* read hardware counters around timed runs */
+    size_t (*alloc_count)(void); /* optional running allocation count */
+} bench_config;
+
+#define BENCH_CONFIG_DEFAULT {1, 5, 1, NULL}
+
+typedef struct {
+    size_t ops;                  /* operations per run */
+    int reps;
+    double ns_min, ns_p50, ns_p90, ns_p99, ns_mean;   /* per operation */
+    double allocs;               /* per operation, averaged over timed runs; -1 if not counted */
+    double counters[BENCH_COUNTERS];   /* per operation; -1 if unavailable */
+} bench_result;
+
+typedef void (*bench_fn)(void *ctx);
+
+static inline int bench_cmp_double(const void *a, const void *b) {
+    const double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of sorted[0..n). */
+static inline double bench_percentile(const double *sorted, int n, double p) {
+    int rank = (int)ceil(p * n);
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1];
+}
+
+/*
+  Runs setup (untimed, may be NULL) then body, warmup + reps times; body
+  performs 'ops' operations. Samples are per-operation wall times.
+*/
+static inline bench_result bench_run(const bench_config *cfg, size_t ops, bench_fn setup, bench_fn body, void *ctx) {
+    bench_result r;
+    memset(&r, 0, sizeof r);
+    r.ops = ops ? ops : 1;
+    r.reps = cfg->reps > 0 ? cfg->reps : 1;
+    for (int w = 0; w < cfg->warmup; ++w) {
+        if (setup) setup(ctx);
+        body(ctx);
+    }
+
+    double *samples = (double *)malloc((size_t)r.reps * sizeof(double));
+    if (!samples) {
+        r.reps = 0;
+        return r;
+    }
+    bench_perf perf;
+    bench_perf_open(&perf, cfg->perf);
+    long long totals[BENCH_COUNTERS] = {0, 0, 0};
+    size_t allocs = 0;
+    double sum = 0.0;
+    for (int i = 0; i < r.reps; ++i) {
+        if (setup) setup(ctx);
+        const size_t a0 = cfg->alloc_count ? cfg->alloc_count() : 0;
+        long long counts[BENCH_COUNTERS];
+        bench_perf_start(&perf);
+        const uint64_t t0 = bench_now_ns();
+        body(ctx);
+        const uint64_t t1 = bench_now_ns();
+        bench_perf_stop(&perf, counts);
+        if (cfg->alloc_count) allocs += cfg->alloc_count() - a0;
+        for (int c = 0; c < BENCH_COUNTERS; ++c) {
+            if (counts[c] < 0 || totals[c] < 0) totals[c] = -1;
+            else totals[c] += counts[c];
+        }
+        samples[i] = (double)(t1 - t0) / (double)r.ops;
+        sum += samples[i];
+    }
+    bench_perf_close(&perf);
+
+    qsort(samples, (size_t)r.reps, sizeof(double), bench_cmp_double);
+    const double runs = (double)r.reps * (double)r.ops;
+    r.ns_min = samples[0];
+    r.ns_p50 = bench_percentile(samples, r.reps, 0.50);
+    r.ns_p90 = bench_percentile(samples, r.reps, 0.90);
+    r.ns_p99 = bench_percentile(samples, r.reps, 0.99);
+    r.ns_mean = sum / r.reps;
+    r.allocs = cfg->alloc_count ? (double)allocs / runs : -1.0;
+    for (int c = 0; c < BENCH_COUNTERS; ++c) r.counters[c] = totals[c] < 0 ? -1.0 : (double)totals[c] / runs;
+    free(samples);
+    return r;
+}
+
+/* ---------- Session: options, output, gate ---------- */
+
+typedef struct {
+    char name[96];
+    size_t n;
+    double ns_p50;
+    double allocs;
+    int matched;
+} bench_baseline_entry;
+
+typedef struct {
+    bench_config cfg;
+    uint64_t seed;
+    const char *suite;
+    const char *json_path;
+    const char *gate_path;
+    double tolerance;
+    FILE *json;
+    int table;
+    bench_baseline_entry *baseline;
+    size_t baseline_count;
+    int regressions;
+    int added;
+} bench_session;
+
+static inline void bench_session_init(bench_session *s, const char *suite) {
+    const bench_config cfg = BENCH_CONFIG_DEFAULT;
+    memset(s, 0, sizeof *s);
+    s->cfg = cfg;
+    s->seed = 1;
+    s->suite = suite;
+    s->tolerance = 0.25;
+    s->table = 1;
+}
+
+/*
+  Consumes argv[*i] (and its value) if it is a common option. Returns 1 if
+  consumed, 0 if not a common option, -1 if it is malformed.
+*/
+static inline int bench_session_option(bench_session *s, int argc, char **argv, int *i) {
+    const char *flag = argv[*i];
+    if (strcmp(flag, "--no-perf") == 0) {
+        s->cfg.perf = 0;
+        return 1;
+    }
+    const int known = strcmp(flag, "--reps") == 0 || strcmp(flag, "--warmup") == 0 ||
+                      strcmp(flag, "--seed") == 0 || strcmp(flag, "--json") == 0 ||
+                      strcmp(flag, "--save-baseline") == 0 || strcmp(flag, "--gate") == 0 ||
+                      strcmp(flag, "--tolerance") == 0;
+    if (!known) return 0;
+    if (*i + 1 >= argc) return -1;
+    const char *value = argv[++*i];
+    if (strcmp(flag, "--reps") == 0) s->cfg.reps = atoi(value) > 0 ? atoi(value) : 1;
+    else if (strcmp(flag, "--warmup") == 0) s->cfg.warmup = atoi(value) > 0 ? atoi(value) : 0;
+    else if (strcmp(flag, "--seed") == 0) s->seed = strtoull(value, NULL, 10);
+    else if (strcmp(flag, "--gate") == 0) s->gate_path = value;
+    else if (strcmp(flag, "--tolerance") == 0) s->tolerance = atof(value);
+    else s->json_path = value;
+    return 1;
+}
+
+/* Reads the fields the gate needs back out of a JSON-lines file written by bench_record(). */
+static inline int bench_load_baseline(bench_session *s, const char *path) {
+    FILE *in = fopen(path, "r");
+    if (!in) return 0;
+    char line[1024];
+    size_t cap = 0;
+    while (fgets(line, sizeof line, in)) {
+        const char *b = strstr(line, "\"bench\":\""), *n = strstr(line, "\"n\":");
+        const char *p50 = strstr(line, "\"ns_p50\":"), *al = strstr(line, "\"allocs\":");
+        if (!b || !n || !p50 || !al) continue;
+        if (s->baseline_count == cap) {
+            cap = cap ? cap * 2 : 64;
+            bench_baseline_entry *grown =
+                (bench_baseline_entry *)realloc(s->baseline, cap * sizeof(bench_baseline_entry));
+            if (!grown) break;
+            s->baseline = grown;
+        }
+        bench_baseline_entry *e = &s->baseline[s->baseline_count];
+        b += strlen("\"bench\":\"");
+        size_t len = strcspn(b, "\"");
+        if (len >= sizeof e->name) len = sizeof e->name - 1;
+        memcpy(e->name, b, len);
+        e->name[len] = '\0';
+        e->n = (size_t)strtoull(n + strlen("\"n\":"), NULL, 10);
+        e->ns_p50 = strtod(p50 + strlen("\"ns_p50\":"), NULL);
+        al += strlen("\"allocs\":");
+        e->allocs = strncmp(al, "null", 4) == 0 ? -1.0 : strtod(al, NULL);
+        e->matched = 0;
+        ++s->baseline_count;
+    }
+    fclose(in);
+    return 1;
+}
+
+/* Opens outputs and loads the gate baseline. 0 (with a message) on failure. */
+static inline int bench_session_start(bench_session *s) {
+    if (s->json_path) {
+        if (strcmp(s->json_path, "-") == 0) {
+            s->json = stdout;
+            s->table = 0;
+        } else if (!(s->json = fopen(s->json_path, "w"))) {
+            perror(s->json_path);
+            return 0;
+        }
+    }
+    if (s->gate_path && !bench_load_baseline(s, s->gate_path)) {
+        perror(s->gate_path);
+        return 0;
+    }
+    if (s->table) {
+        printf("suite=%s reps=%d warmup=%d seed=%llu\n", s->suite, s->cfg.reps, s->cfg.warmup,
+               (unsigned long long)s->seed);
+        printf("%-28s %10s %11s %11s %11s %11s %10s %13s %11s\n", "bench", "n", "p50 ns/op", "p90 ns/op",
+               "p99 ns/op", "min ns/op", "allocs/op", "instr/op", "misses/op");
+    }
+    return 1;
+}
+
+static inline void bench_json_number(FILE *out, const char *key, double v, int places) {
+    if (v < 0) fprintf(out, ",\"%s\":null", key);
+    else fprintf(out, ",\"%s\":%.*f", key, places, v);
+}
+
+static inline void bench_table_number(double v, int width, int places) {
+    if (v < 0) printf(" %*s", width, "n/a");
+    else printf(" %*.*f", width, places, v);
+}
+
+/* Prints, emits and gates one result. */
+static inline void bench_record(bench_session *s, const char *name, size_t n, const bench_result *r) {
+    if (s->table) {
+        printf("%-28s %10zu", name, n);
+        bench_table_number(r->ns_p50, 11, 2);
+        bench_table_number(r->ns_p90, 11, 2);
+        bench_table_number(r->ns_p99, 11, 2);
+        bench_table_number(r->ns_min, 11, 2);
+        bench_table_number(r->allocs, 10, 3);
+        bench_table_number(r->counters[BENCH_INSTRUCTIONS], 13, 1);
+        bench_table_number(r->counters[BENCH_CACHE_MISSES], 11, 3);
+        putchar('\n');
+    }
+    if (s->json) {
+        fprintf(s->json, "{\"suite\":\"%s\",\"bench\":\"%s\",\"n\":%zu,\"ops\":%zu,\"reps\":%d", s->suite, name, n,
+                r->ops, r->reps);
+        bench_json_number(s->json, "ns_min", r->ns_min, 3);
+        bench_json_number(s->json, "ns_p50", r->ns_p50, 3);
+        bench_json_number(s->json, "ns_p90", r->ns_p90, 3);
+        bench_json_number(s->json, "ns_p99", r->ns_p99, 3);
+        bench_json_number(s->json, "ns_mean", r->ns_mean, 3);
+        bench_json_number(s->json, "allocs", r->allocs, 9);
+        for (int c = 0; c < BENCH_COUNTERS; ++c) bench_json_number(s->json, bench_counter_names[c], r->counters[c], 3);
+        fputs("}\n", s->json);
+    }
+    if (!s->gate_path) return;
+    /* First unmatched entry, so a (name, n) recorded twice pairs with its own baseline lines in order. */
+    size_t i = 0;
+    while (i < s->baseline_count &&
+           (s->baseline[i].matched || s->baseline[i].n != n || strcmp(s->baseline[i].name, name) != 0))
+        ++i;
+    bench_baseline_entry *e = i < s->baseline_count ? &s->baseline[i] : NULL;
+    if (e) e->matched = 1;
+    if (r->reps == 0) {
+        /* bench_run() could not allocate its samples; an unmeasured result must not pass. */
+        ++s->regressions;
+        fprintf(stderr, "REGRESSION %s n=%zu: not measured\n", name, n);
+        return;
+    }
+    if (!e) {
+        ++s->added;
+        fprintf(stderr, "NEW %s n=%zu: not in the baseline\n", name, n);
+        return;
+    }
+    const int slower = r->ns_p50 > e->ns_p50 * (1.0 + s->tolerance);
+    const int allocs = e->allocs >= 0 && r->allocs > e->allocs + 1e-6;
+    if (slower || allocs) {
+        ++s->regressions;
+        fprintf(stderr, "REGRESSION %s n=%zu: p50 %.2f ns/op (baseline %.2f)", name, n, r->ns_p50, e->ns_p50);
+        if (e->allocs >= 0) fprintf(stderr, ", %.3f allocs/op (baseline %.3f)", r->allocs, e->allocs);
+        fputc('\n', stderr);
+    }
+}
+
+/* A non-timing measurement (e.g. peak RSS) in the same outputs; never gated. */
+static inline void bench_note(bench_session *s, const char *metric, size_t n, double value) {
+    if (s->table) printf("%-28s %10zu  %.0f\n", metric, n, value);
+    if (s->json) fprintf(s->json, "{\"suite\":\"%s\",\"metric\":\"%s\",\"n\":%zu,\"value\":%.0f}\n", s->suite, metric, n, value);
+}
+
+/*
+  Closes outputs and reports the gate. A baseline bench that never ran fails the gate like a
+  regression, so dropping a bench cannot hide one. Returns the process exit code: 0, or 2 on failure.
+*/
+static inline int bench_session_finish(bench_session *s) {
+    if (s->json && s->json != stdout) fclose(s->json);
+    if (s->json == stdout) fflush(stdout);
+    s->json = NULL;
+    int missing = 0;
+    for (size_t i = 0; i < s->baseline_count; ++i) {
+        if (s->baseline[i].matched) continue;
+        ++missing;
+        fprintf(stderr, "MISSING %s n=%zu: in the baseline but not run\n", s->baseline[i].name, s->baseline[i].n);
+    }
+    free(s->baseline);
+    s->baseline = NULL;
+    s->baseline_count = 0;
+    if (!s->gate_path) return 0;
+    const int failed = s->regressions || missing;
+    fprintf(s->table ? stdout : stderr, "gate: %s (%d regressed, %d missing, %d new, tolerance %.0f%%)\n",
+            failed ? "FAIL" : "PASS", s->regressions, missing, s->added, s->tolerance * 100.0);
+    return failed ? 2 : 0;
+}
+
+/* ---------- C++ adapter ---------- */
+
+#ifdef __cplusplus
+#include <type_traits>
+
+template <typename S, typename F>
+struct BenchThunk {
+    S& setup;
+    F& body;
+    static void runSetup(void* ctx) { static_cast<BenchThunk*>(ctx)->setup(); }
+    static void runBody(void* ctx) { static_cast<BenchThunk*>(ctx)->body(); }
+};
+
+// bench_run() for lambdas: `setup` runs untimed before every run of `body`.
+template <typename S, typename F>
+inline bench_result bench_measure(const bench_config& cfg, size_t ops, S&& setup, F&& body) {
+    BenchThunk<std::remove_reference_t<S>, std::remove_reference_t<F>> thunk{setup, body};
+    return bench_run(&cfg, ops, thunk.runSetup, thunk.runBody, &thunk);
+}
+
+template <typename F>
+inline bench_result bench_measure(const bench_config& cfg, size_t ops, F&& body) {
+    return bench_measure(cfg, ops, [] {}, body);
+}
+#endif
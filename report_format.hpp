@@ -0,0 +1,96 @@
+// Shared text-report formatting for ride_share.cpp and scheduler.cpp.
+//
+// Reports are rendered into a ReportBuffer, a growable contiguous byte buffer,
+// and handed to the OS in large chunks (one fwrite, or one ostream::write, per
+// flush). Numbers go through std::to_chars, so there are no stream manipulators,
+// no locale lookups and no sticky stream state: "%.2f" and decimal(v, 2) give
+// the same digits. Once the buffer has grown to the size of the largest report,
+// rendering allocates nothing.
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+class ReportBuffer {
+    std::vector<char> bytes;
+    size_t used = 0;
+
+    char* reserve(size_t n) {
+        if (used + n > bytes.size()) bytes.resize(std::max(bytes.size() * 2, used + n));
+        return bytes.data() + used;
+    }
+
+public:
+    explicit ReportBuffer(size_t capacity = 16 * 1024) : bytes(capacity) {}
+
+    ReportBuffer& put(std::string_view s) {
+        std::memcpy(reserve(s.size()), s.data(), s.size());
+        used += s.size();
+        return *this;
+    }
+
+    ReportBuffer& put(char c) {
+        *reserve(1) = c;
+        ++used;
+        return *this;
+    }
+
+    // `s` left-justified in a field of `width` characters (like setw + left).
+    ReportBuffer& padded(std::string_view s, size_t width) {
+        put(s);
+        if (s.size() < width) {
+            std::memset(reserve(width - s.size()), ' ', width - s.size());
+            used += width - s.size();
+        }
+        return *this;
+    }
+
+    // Fixed-point with `places` decimals, rounded like printf.
+    ReportBuffer& decimal(double v, int places = 2) {
+        // 32 bytes covers any realistic fare or distance; retry big for the rest.
+        for (size_t room : {size_t{32}, size_t{400}}) {
+            char* p = reserve(room);
+            const auto res = std::to_chars(p, p + room, v, std::chars_format::fixed, places);
+            if (res.ec == std::errc()) {
+                used += static_cast<size_t>(res.ptr - p);
+                break;
+            }
+        }
+        return *this;
+    }
+
+    template <typename Int>
+    ReportBuffer& integer(Int v) {
+        char* p = reserve(24);
+        used += static_cast<size_t>(std::to_chars(p, p + 24, v).ptr - p);
+        return *this;
+    }
+
+    std::string_view view() const { return {bytes.data(), used}; }
+    size_t size() const { return used; }
+    void clear() { used = 0; }
+
+    void flush(std::FILE* out) {
+        if (used) std::fwrite(bytes.data(), 1, used, out);
+        used = 0;
+    }
+
+    void flush(std::ostream& os) {
+        if (used) os.write(bytes.data(), static_cast<std::streamsize>(used));
+        used = 0;
+    }
+};
+
+// Per-thread scratch buffer for the ostream convenience wrappers, so a wrapper
+// call does not allocate a fresh buffer each time.
+inline ReportBuffer& scratchReport() {
+    thread_local ReportBuffer buffer;
+    buffer.clear();
+    return buffer;
+}
@@ -1,19 +1,298 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
 #include <iostream>
-#include <iomanip>
+#include <limits>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <variant>
 #include <vector>
 #include <numeric>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "report_format.hpp"
+
+// Fares must round the same way on every code path, so no multiply-add
+// contraction anywhere in this file (GCC contracts by default in C++ modes),
+// and no reassociation even under -ffast-math, which would let the compiler
+// fold a tier's constant rates differently in different loops. The settings
+// are pushed here and popped at the end of the file, so code that includes it
+// (ride_share_bench.cpp) keeps its own flags.
+#if defined(__clang__)
+#pragma float_control(push)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off", "no-associative-math")
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RIDE_SHARE_HAVE_AVX2 1
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RIDE_SHARE_HAVE_NEON 1
+#endif
+
 using std::cout;
 using std::endl;
-using std::fixed;
 using std::make_shared;
-using std::setprecision;
 using std::shared_ptr;
 using std::string;
+using std::unordered_map;
 using std::vector;
 
+// ---------------------------- Pricing ----------------------------
+// A tier's fare is a compile-time PricingPolicy: base + per-mile, with the
+// distance part shaped by a SurgeModel. Every fare path in the file (virtual
+// fare(), RideStore, the variant loop, the batch kernel) prices through the
+// policies in RideTiers, so they agree exactly.
+//
+// Adding a tier: add a RideKind, define its Tier struct, append it to RideTiers.
+// The loops below are generic over the list and need no change.
+enum class RideKind : uint8_t { Standard = 0, Premium = 1, XL = 2, Pool = 3 };
+
+// --- Surge models: how the surge column scales the distance part ---
+
+// Flat pricing; the surge column is ignored.
+struct NoSurge {
+    static double apply(double distancePart, double) { return distancePart; }
+    static double effective(double, int) { return 1.0; }
+#ifdef RIDE_SHARE_HAVE_AVX2
+    __attribute__((target("avx2"))) static __m256d apply(__m256d distancePart, __m256d) { return distancePart; }
+#endif
+#ifdef RIDE_SHARE_HAVE_NEON
+    static float64x2_t apply(float64x2_t distancePart, float64x2_t) { return distancePart; }
+#endif
+};
+
+// Distance part × live demand multiplier.
+struct DemandSurge {
+    static double apply(double distancePart, double surge) { return distancePart * surge; }
+    static double effective(double demand, int) { return demand; }
+#ifdef RIDE_SHARE_HAVE_AVX2
+    __attribute__((target("avx2"))) static __m256d apply(__m256d distancePart, __m256d surge) {
+        return _mm256_mul_pd(distancePart, surge);
+    }
+#endif
+#ifdef RIDE_SHARE_HAVE_NEON
+    static float64x2_t apply(float64x2_t distancePart, float64x2_t surge) { return vmulq_f64(distancePart, surge); }
+#endif
+};
+
+// Distance part × a fixed multiplier chosen by pickup hour (rush hours cost
+// more). The hour is resolved when the ride is created, so at fare time this
+// is the same multiply as DemandSurge and the batch loop never sees a clock.
+struct TimeOfDaySurge : DemandSurge {
+    static double effective(double, int hourOfDay) {
+        const bool rush = (hourOfDay >= 7 && hourOfDay < 10) || (hourOfDay >= 16 && hourOfDay < 19);
+        return rush ? 1.25 : 1.0;
+    }
+};
+
+// Rates are in cents so they can be template arguments.
+template <long BaseCents, long PerMileCents, typename SurgeModel>
+struct PricingPolicy {
+    using Surge = SurgeModel;
+    static constexpr double base = BaseCents / 100.0;
+    static constexpr double perMile = PerMileCents / 100.0;
+
+    static double fare(double miles, double surge) {
+        return base + Surge::apply(miles * perMile, surge);
+    }
+#ifdef RIDE_SHARE_HAVE_AVX2
+    __attribute__((target("avx2"))) static __m256d fare(__m256d miles, __m256d surge) {
+        return _mm256_add_pd(_mm256_set1_pd(base), Surge::apply(_mm256_mul_pd(miles, _mm256_set1_pd(perMile)), surge));
+    }
+#endif
+#ifdef RIDE_SHARE_HAVE_NEON
+    static float64x2_t fare(float64x2_t miles, float64x2_t surge) {
+        return vaddq_f64(vdupq_n_f64(base), Surge::apply(vmulq_f64(miles, vdupq_n_f64(perMile)), surge));
+    }
+#endif
+};
+
+// --- Tiers ---
+struct StandardTier {
+    static constexpr RideKind kind = RideKind::Standard;
+    static constexpr std::string_view name = "Standard";
+    using Pricing = PricingPolicy<300, 150, NoSurge>;         // $3.00 + $1.50/mi
+};
+
+struct PremiumTier {
+    static constexpr RideKind kind = RideKind::Premium;
+    static constexpr std::string_view name = "Premium";
+    using Pricing = PricingPolicy<500, 250, DemandSurge>;     // $5.00 + $2.50/mi × surge
+};
+
+struct XLTier {
+    static constexpr RideKind kind = RideKind::XL;
+    static constexpr std::string_view name = "XL";
+    using Pricing = PricingPolicy<700, 325, DemandSurge>;     // $7.00 + $3.25/mi × surge
+};
+
+struct PoolTier {
+    static constexpr RideKind kind = RideKind::Pool;
+    static constexpr std::string_view name = "Pool";
+    using Pricing = PricingPolicy<200, 100, TimeOfDaySurge>;  // $2.00 + $1.00/mi × rush hour
+};
+
+template <typename... Tiers>
+struct TierList {
+    static constexpr size_t size = sizeof...(Tiers);
+};
+
+using RideTiers = TierList<StandardTier, PremiumTier, XLTier, PoolTier>;
+constexpr size_t NUM_RIDE_KINDS = RideTiers::size;
+
+namespace pricing_detail {
+
+template <typename... T>
+constexpr bool kindsMatchPositions(TierList<T...>) {
+    size_t i = 0;
+    return ((static_cast<size_t>(T::kind) == i++) && ...);
+}
+static_assert(kindsMatchPositions(RideTiers{}), "RideTiers must list tiers in RideKind order");
+
+template <typename... T>
+inline double fare(TierList<T...>, RideKind kind, double miles, double surge) {
+    double out = 0.0;
+    (void)((kind == T::kind ? (out = T::Pricing::fare(miles, surge), true) : false) || ...);
+    return out;
+}
+
+template <typename... T>
+constexpr std::string_view name(TierList<T...>, RideKind kind) {
+    std::string_view out = "Unknown";
+    (void)((kind == T::kind ? (out = T::name, true) : false) || ...);
+    return out;
+}
+
+template <typename... T>
+inline double effectiveSurge(TierList<T...>, RideKind kind, double demand, int hourOfDay) {
+    double out = 1.0;
+    (void)((kind == T::kind ? (out = T::Pricing::Surge::effective(demand, hourOfDay), true) : false) || ...);
+    return out;
+}
+
+} // namespace pricing_detail
+
+inline double tierFare(RideKind kind, double miles, double surge) {
+    return pricing_detail::fare(RideTiers{}, kind, miles, surge);
+}
+
+constexpr std::string_view rideKindName(RideKind kind) { return pricing_detail::name(RideTiers{}, kind); }
+
+// Value for a ride's surge column, from the live demand multiplier and pickup hour.
+inline double tierSurge(RideKind kind, double demand, int hourOfDay) {
+    return pricing_detail::effectiveSurge(RideTiers{}, kind, demand, hourOfDay);
+}
+
+// ----------------------------- Batch fare kernel -----------------------------
+// computeFares() prices a whole batch: out[i] = fare of (miles[i], surge[i], kind[i]).
+// The SIMD paths price every tier per lane and blend by kind, doing exactly
+// the scalar operations in the same order (separate multiply and add, never
+// FMA), so every path is bit-identical to tierFare().
+inline void computeFaresScalar(const double* miles, const double* surge, const RideKind* kind,
+                               double* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) out[i] = tierFare(kind[i], miles[i], surge[i]);
+}
+
+// Homogeneous batch of one tier: a straight arithmetic loop the compiler vectorizes.
+template <typename Tier>
+inline void computeFaresUniform(const double* miles, const double* surge, double* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) out[i] = Tier::Pricing::fare(miles[i], surge[i]);
+}
+
+#ifdef RIDE_SHARE_HAVE_AVX2
+namespace pricing_detail {
+template <typename... T>
+__attribute__((target("avx2"))) inline __m256d fareAVX2(TierList<T...>, __m256d m, __m256d s, __m256i kind) {
+    __m256d out = _mm256_setzero_pd();
+    ((out = _mm256_blendv_pd(out, T::Pricing::fare(m, s),
+                             _mm256_castsi256_pd(_mm256_cmpeq_epi64(
+                                 kind, _mm256_set1_epi64x(static_cast<long long>(T::kind)))))), ...);
+    return out;
+}
+} // namespace pricing_detail
+
+__attribute__((target("avx2")))
+inline void computeFaresAVX2(const double* miles, const double* surge, const RideKind* kind,
+                             double* out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256d m = _mm256_loadu_pd(miles + i);
+        const __m256d s = _mm256_loadu_pd(surge + i);
+        int32_t tags;
+        std::memcpy(&tags, kind + i, sizeof(tags));
+        const __m256i widened = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(tags));
+        _mm256_storeu_pd(out + i, pricing_detail::fareAVX2(RideTiers{}, m, s, widened));
+    }
+    computeFaresScalar(miles + i, surge + i, kind + i, out + i, n - i);
+}
+#endif
+
+#ifdef RIDE_SHARE_HAVE_NEON
+namespace pricing_detail {
+template <typename... T>
+inline float64x2_t fareNEON(TierList<T...>, float64x2_t m, float64x2_t s, uint64x2_t kind) {
+    float64x2_t out = vdupq_n_f64(0.0);
+    ((out = vbslq_f64(vceqq_u64(kind, vdupq_n_u64(static_cast<uint64_t>(T::kind))), T::Pricing::fare(m, s), out)),
+     ...);
+    return out;
+}
+} // namespace pricing_detail
+
+inline void computeFaresNEON(const double* miles, const double* surge, const RideKind* kind,
+                             double* out, size_t n) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const float64x2_t m = vld1q_f64(miles + i);
+        const float64x2_t s = vld1q_f64(surge + i);
+        uint64x2_t tags = vdupq_n_u64(static_cast<uint64_t>(kind[i]));
+        tags = vsetq_lane_u64(static_cast<uint64_t>(kind[i + 1]), tags, 1);
+        vst1q_f64(out + i, pricing_detail::fareNEON(RideTiers{}, m, s, tags));
+    }
+    computeFaresScalar(miles + i, surge + i, kind + i, out + i, n - i);
+}
+#endif
+
+inline void computeFares(const double* miles, const double* surge, const RideKind* kind,
+                         double* out, size_t n) {
+#if defined(RIDE_SHARE_HAVE_AVX2)
+    static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+    if (hasAVX2) {
+        computeFaresAVX2(miles, surge, kind, out, n);
+        return;
+    }
+#elif defined(RIDE_SHARE_HAVE_NEON)
+    computeFaresNEON(miles, surge, kind, out, n);
+    return;
+#endif
+    computeFaresScalar(miles, surge, kind, out, n);
+}
+
 // ---------------------------- Base Class ----------------------------
 class Ride {
 protected:
@@ -34,13 +313,21 @@ public:
     // Polymorphic interface
     virtual double fare() const = 0;
     virtual string rideType() const = 0;
+    virtual RideKind kind() const = 0;
+    virtual double surge() const { return 1.0; }
 
     // Non-virtual helper that uses dynamic dispatch internally
-    virtual void rideDetails(std::ostream& os) const {
-        os << "[" << rideType() << "] " << rideID
-           << " | " << pickupLocation << " → " << dropoffLocation
-           << " | " << distance << " mi"
-           << " | fare: $" << fixed << setprecision(2) << fare();
+    virtual void rideDetails(ReportBuffer& out) const {
+        out.put('[').put(rideKindName(kind())).put("] ").put(rideID)
+           .put(" | ").put(pickupLocation).put(" → ").put(dropoffLocation)
+           .put(" | ").decimal(distance).put(" mi")
+           .put(" | fare: $").decimal(fare());
+    }
+
+    void rideDetails(std::ostream& os) const {
+        auto& out = scratchReport();
+        rideDetails(out);
+        out.flush(os);
     }
 
     // Read-only accessors (encapsulation: no direct mutation)
@@ -51,63 +338,484 @@ public:
 };
 
 // ---------------------- Derived Classes (Inheritance) ----------------------
-class StandardRide : public Ride {
-    // Example pricing: $3.00 base + $1.50 per mile
+// One class template covers every tier; its fare() inlines the tier's policy.
+template <typename Tier>
+class TierRide : public Ride {
+    double surgeMultiplier;
+
 public:
-    using Ride::Ride; // inherit constructor
+    TierRide(string id, string pickup, string dropoff, double miles, double surge = 1.0)
+        : Ride(std::move(id), std::move(pickup), std::move(dropoff), miles),
+          surgeMultiplier(surge) {}
+
     double fare() const override {
-        return 3.00 + miles() * 1.50;
+        return Tier::Pricing::fare(miles(), surgeMultiplier);
     }
-    string rideType() const override { return "Standard"; }
+    string rideType() const override { return string(Tier::name); }
+    RideKind kind() const override { return Tier::kind; }
+    double surge() const override { return surgeMultiplier; }
 };
 
-class PremiumRide : public Ride {
-    // Example pricing: $5.00 base + $2.50 per mile × surge multiplier
-    double surgeMultiplier;
+using StandardRide = TierRide<StandardTier>;
+using PremiumRide = TierRide<PremiumTier>;
+using XLRide = TierRide<XLTier>;
+using PoolRide = TierRide<PoolTier>;
+
+// ---------------------- Value rides (std::variant) ----------------------
+// Closed set of small by-value rides for tight loops: std::visit resolves to
+// the tier's inlined policy, with no heap object or vtable per ride.
+template <typename Tier>
+struct RideValue {
+    static constexpr RideKind kind = Tier::kind;
+    double miles;
+    double surge = 1.0;
+
+    double fare() const { return Tier::Pricing::fare(miles, surge); }
+};
+
+namespace pricing_detail {
+template <typename... T>
+std::variant<RideValue<T>...> variantOf(TierList<T...>);
+
+template <typename V, typename... T>
+V makeValue(TierList<T...>, RideKind kind, double miles, double surge) {
+    V out = RideValue<StandardTier>{miles, surge};
+    (void)((kind == T::kind ? (out = RideValue<T>{miles, surge}, true) : false) || ...);
+    return out;
+}
+} // namespace pricing_detail
+
+using AnyRide = decltype(pricing_detail::variantOf(RideTiers{}));
+
+inline AnyRide makeAnyRide(RideKind kind, double miles, double surge = 1.0) {
+    return pricing_detail::makeValue<AnyRide>(RideTiers{}, kind, miles, surge);
+}
+
+inline double rideFare(const AnyRide& ride) {
+    return std::visit([](const auto& r) { return r.fare(); }, ride);
+}
+
+inline double totalFare(const vector<AnyRide>& rides) {
+    double sum = 0.0;
+    for (const auto& r : rides) sum += rideFare(r);
+    return sum;
+}
+
+// ----------------------------- Location interning -----------------------------
+using LocationId = uint32_t;
+
+// Copies `s` into `arena` and returns a view of the copy.
+inline std::string_view arenaCopy(std::pmr::memory_resource& arena, std::string_view s) {
+    if (s.empty()) return {};
+    char* p = static_cast<char*>(arena.allocate(s.size(), 1));
+    std::memcpy(p, s.data(), s.size());
+    return {p, s.size()};
+}
+
+// Each distinct location name is stored once, in the owning batch's arena;
+// rides refer to it by a 4-byte LocationId.
+class LocationTable {
+    std::pmr::memory_resource* arena;
+    std::pmr::vector<std::string_view> names;
+    std::pmr::unordered_map<std::string_view, LocationId> ids;
 
 public:
-    PremiumRide(string id, string pickup, string dropoff, double miles, double surge = 1.0)
-        : Ride(std::move(id), std::move(pickup), std::move(dropoff), miles),
-          surgeMultiplier(surge) {}
+    explicit LocationTable(std::pmr::memory_resource* mem) : arena(mem), names(mem), ids(mem) {}
 
-    double fare() const override {
-        return 5.00 + miles() * 2.50 * surgeMultiplier;
+    LocationId intern(std::string_view name) {
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+        const auto id = static_cast<LocationId>(names.size());
+        names.push_back(arenaCopy(*arena, name));
+        ids.emplace(names.back(), id);
+        return id;
+    }
+
+    std::string_view name(LocationId id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+};
+
+// ------------------------------- RideStore (SoA) -------------------------------
+// Struct-of-arrays ride storage: one column per field, locations interned to
+// 4-byte ids. Fares are computed by a type-switched loop over the columns
+// instead of a virtual call per heap object. The Ride classes remain the
+// public value/adapter types: add() ingests one, materialize() rebuilds one.
+//
+// A store holds one batch (e.g. a day of trips). Ride IDs, location names and
+// the ID index live in a monotonic arena, so ingesting costs no per-ride heap
+// allocation once the columns have grown, and reset() drops the whole batch at
+// once. reset() invalidates every RideIndex handed out for the batch.
+using RideIndex = uint32_t;
+
+class RideStore {
+    // Everything whose lifetime is the batch; rebuilt wholesale by reset().
+    struct Batch {
+        std::pmr::monotonic_buffer_resource arena{64 * 1024};
+        LocationTable locations{&arena};
+        std::pmr::unordered_map<std::string_view, RideIndex> byID{&arena};
+    };
+
+    vector<std::string_view> rideIDs;   // views into batch->arena
+    vector<double> distances;   // miles
+    vector<double> surges;      // 1.0 for Standard
+    vector<RideKind> kinds;
+    vector<LocationId> pickups;
+    vector<LocationId> dropoffs;
+    std::unique_ptr<Batch> batch = std::make_unique<Batch>();
+
+public:
+    // Rides are keyed by rideID: adding an ID that is already stored returns its index.
+    RideIndex add(RideKind kind, std::string_view id, std::string_view pickup, std::string_view dropoff,
+                  double miles, double surge = 1.0) {
+        auto found = batch->byID.find(id);
+        if (found != batch->byID.end()) return found->second;
+        const auto index = static_cast<RideIndex>(rideIDs.size());
+        rideIDs.push_back(arenaCopy(batch->arena, id));
+        batch->byID.emplace(rideIDs.back(), index);
+        distances.push_back(miles);
+        surges.push_back(surge);
+        kinds.push_back(kind);
+        pickups.push_back(batch->locations.intern(pickup));
+        dropoffs.push_back(batch->locations.intern(dropoff));
+        return index;
+    }
+
+    RideIndex add(const Ride& ride) {
+        return add(ride.kind(), ride.id(), ride.pickup(), ride.dropoff(), ride.miles(), ride.surge());
+    }
+
+    size_t size() const { return rideIDs.size(); }
+
+    void reserve(size_t n) {
+        rideIDs.reserve(n);
+        distances.reserve(n);
+        surges.reserve(n);
+        kinds.reserve(n);
+        pickups.reserve(n);
+        dropoffs.reserve(n);
+        batch->byID.reserve(n);
+    }
+
+    // Ends the batch: columns keep their capacity, the arena is released in one go.
+    void reset() {
+        rideIDs.clear();
+        distances.clear();
+        surges.clear();
+        kinds.clear();
+        pickups.clear();
+        dropoffs.clear();
+        batch.reset();
+        batch = std::make_unique<Batch>();
+    }
+
+    double fare(RideIndex i) const { return tierFare(kinds[i], distances[i], surges[i]); }
+
+    AnyRide value(RideIndex i) const { return makeAnyRide(kinds[i], distances[i], surges[i]); }
+
+    // Fares for every stored ride, in index order, through the batch kernel.
+    void computeFares(vector<double>& out) const {
+        out.resize(size());
+        ::computeFares(distances.data(), surges.data(), kinds.data(), out.data(), size());
+    }
+
+    double totalFare(const vector<RideIndex>& rides) const {
+        double sum = 0.0;
+        for (RideIndex i : rides) sum += fare(i);
+        return sum;
+    }
+
+    std::string_view id(RideIndex i) const { return rideIDs[i]; }
+    std::string_view pickup(RideIndex i) const { return batch->locations.name(pickups[i]); }
+    std::string_view dropoff(RideIndex i) const { return batch->locations.name(dropoffs[i]); }
+    double miles(RideIndex i) const { return distances[i]; }
+    double surge(RideIndex i) const { return surges[i]; }
+    RideKind kind(RideIndex i) const { return kinds[i]; }
+    LocationId pickupID(RideIndex i) const { return pickups[i]; }
+    LocationId dropoffID(RideIndex i) const { return dropoffs[i]; }
+    const LocationTable& locationTable() const { return batch->locations; }
+
+    // Same text as Ride::rideDetails, straight from the columns.
+    void rideDetails(RideIndex i, ReportBuffer& out) const {
+        out.put('[').put(rideKindName(kinds[i])).put("] ").put(rideIDs[i])
+           .put(" | ").put(pickup(i)).put(" → ").put(dropoff(i))
+           .put(" | ").decimal(distances[i]).put(" mi")
+           .put(" | fare: $").decimal(fare(i));
+    }
+
+    // Rebuilds a standalone Ride object for code that still wants the class hierarchy.
+    shared_ptr<Ride> materialize(RideIndex i) const;
+};
+
+// ----------------------------- Concurrent ledger -----------------------------
+// Append-only log that many threads may append to while others read, with no
+// locks. An append reserves a slot with one fetch_add, writes it, marks it
+// ready, then helps advance `published` over the ready prefix. Readers take
+// published() once and see exactly that prefix: a consistent snapshot that
+// never blocks producers. A stalled producer only delays publication of later
+// slots; it never loses them.
+//
+// Storage is a fixed directory of segments that double in size (16, 32, ...),
+// so an empty ledger costs a few hundred bytes and slots never move.
+template <typename T>
+class ConcurrentLedger {
+    static constexpr size_t FIRST = 16;
+    static constexpr size_t SEGMENTS = 28; // ~4G slots
+
+    struct Slot {
+        T value;
+        std::atomic<bool> ready{false};
+    };
+
+    std::atomic<Slot*> segments[SEGMENTS] = {};
+    std::atomic<size_t> reserved{0};
+    std::atomic<size_t> publishedCount{0};
+
+    static size_t segmentOf(size_t i) {
+        size_t j = i / FIRST + 1, k = 0;
+        while (j >>= 1) ++k;
+        return k;
+    }
+    static size_t segmentStart(size_t k) { return FIRST * ((size_t{1} << k) - 1); }
+    static size_t segmentSize(size_t k) { return FIRST << k; }
+
+    Slot* segment(size_t k) {
+        Slot* seg = segments[k].load(std::memory_order_acquire);
+        if (seg) return seg;
+        Slot* fresh = new Slot[segmentSize(k)];
+        if (segments[k].compare_exchange_strong(seg, fresh, std::memory_order_acq_rel)) return fresh;
+        delete[] fresh; // another producer installed it first
+        return seg;
+    }
+
+    const T& at(size_t i) const {
+        const size_t k = segmentOf(i);
+        return segments[k].load(std::memory_order_acquire)[i - segmentStart(k)].value;
+    }
+
+public:
+    ConcurrentLedger() = default;
+    ConcurrentLedger(const ConcurrentLedger&) = delete;
+    ConcurrentLedger& operator=(const ConcurrentLedger&) = delete;
+    ~ConcurrentLedger() {
+        for (auto& seg : segments) delete[] seg.load();
+    }
+
+    void append(const T& value) {
+        const size_t i = reserved.fetch_add(1);
+        const size_t k = segmentOf(i);
+        Slot& slot = segment(k)[i - segmentStart(k)];
+        slot.value = value;
+        slot.ready.store(true);
+
+        // Publish every ready slot past the current prefix. Whichever producer
+        // finishes last in a run of slots carries `published` over all of them.
+        size_t p = publishedCount.load();
+        while (p < reserved.load()) {
+            const size_t pk = segmentOf(p);
+            Slot* seg = segments[pk].load();
+            if (!seg || !seg[p - segmentStart(pk)].ready.load()) break;
+            if (publishedCount.compare_exchange_weak(p, p + 1)) ++p;
+        }
+    }
+
+    // Number of entries visible to readers right now.
+    size_t published() const { return publishedCount.load(); }
+
+    // Visits the first n entries in append order; n must not exceed a value
+    // previously returned by published().
+    template <typename F>
+    void forEach(size_t n, F&& f) const {
+        for (size_t k = 0; segmentStart(k) < n; ++k) {
+            const Slot* seg = segments[k].load(std::memory_order_acquire);
+            const size_t end = std::min(segmentSize(k), n - segmentStart(k));
+            for (size_t i = 0; i < end; ++i) f(seg[i].value);
+        }
+    }
+};
+
+// ----------------------------- Earnings aggregates -----------------------------
+// Money is aggregated in integer cents: each fare is rounded once on the way
+// in, and after that sums are exact and order-independent, which is what lets
+// concurrent producers update them with plain fetch_adds.
+using Cents = int64_t;
+
+// Rounds to the cent the same way "%.2f" prints the fare, so a statement's
+// line items always add up to its total. The product is only ambiguous when it
+// lands exactly on .5; the fma residual then says which side the real value is.
+inline Cents toCents(double dollars) {
+    const double scaled = dollars * 100.0;
+    const double lower = std::floor(scaled);
+    const double frac = scaled - lower;
+    if (frac != 0.5) return static_cast<Cents>(frac < 0.5 ? lower : lower + 1.0);
+    const double residual = std::fma(dollars, 100.0, -scaled);
+    if (residual != 0.0) return static_cast<Cents>(residual > 0.0 ? lower + 1.0 : lower);
+    return static_cast<Cents>(std::fmod(lower, 2.0) == 0.0 ? lower : lower + 1.0); // exact tie: to even
+}
+
+inline int64_t nowSeconds() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Ring of N time buckets, each `bucketSeconds` wide, for trailing-window sums.
+// A bucket packs its absolute bucket number (high 26 bits) with its cents
+// (low 38 bits) in one word, so rolling a stale bucket over and adding to it is
+// a single CAS. Windows are bucket-aligned: "last hour" over minute buckets is
+// the current minute plus the 59 before it.
+template <size_t N>
+class EarningsRing {
+    static constexpr int TAG_SHIFT = 38;
+    static constexpr uint64_t CENTS_MASK = (uint64_t{1} << TAG_SHIFT) - 1;
+    static constexpr uint64_t TAG_MASK = (uint64_t{1} << (64 - TAG_SHIFT)) - 1;
+
+    int64_t bucketSeconds;
+    std::atomic<uint64_t> buckets[N] = {};
+
+    static uint64_t tagOf(int64_t bucket) { return static_cast<uint64_t>(bucket) & TAG_MASK; }
+
+public:
+    explicit EarningsRing(int64_t width) : bucketSeconds(width) {}
+
+    void add(int64_t atSeconds, Cents cents) {
+        const int64_t bucket = atSeconds / bucketSeconds;
+        const uint64_t tag = tagOf(bucket);
+        auto& slot = buckets[static_cast<size_t>(bucket) % N];
+        uint64_t cur = slot.load(std::memory_order_relaxed);
+        for (;;) {
+            const uint64_t curTag = cur >> TAG_SHIFT;
+            if (curTag > tag) return; // older than anything the ring still covers
+            const uint64_t base = curTag == tag ? (cur & CENTS_MASK) : 0;
+            const uint64_t next = (tag << TAG_SHIFT) | ((base + static_cast<uint64_t>(cents)) & CENTS_MASK);
+            if (slot.compare_exchange_weak(cur, next, std::memory_order_relaxed)) return;
+        }
+    }
+
+    // Sum of the `span` buckets ending with the one containing `nowSecs` (span <= N).
+    Cents sum(int64_t nowSecs, size_t span) const {
+        const int64_t last = nowSecs / bucketSeconds;
+        Cents total = 0;
+        for (int64_t b = last - static_cast<int64_t>(span) + 1; b <= last; ++b) {
+            const uint64_t v = buckets[static_cast<size_t>(b) % N].load(std::memory_order_relaxed);
+            if ((v >> TAG_SHIFT) == tagOf(b)) total += static_cast<Cents>(v & CENTS_MASK);
+        }
+        return total;
+    }
+};
+
+enum class EarningsWindow { Hour, Day, Week };
+
+// Running totals updated on every addRide; every query is O(1) in the number of
+// rides (windows read at most 168 buckets).
+class EarningsAggregates {
+    std::atomic<Cents> totalCents{0};
+    std::atomic<uint64_t> totalCount{0};
+    std::atomic<Cents> kindCents[NUM_RIDE_KINDS] = {};
+    std::atomic<uint64_t> kindCount[NUM_RIDE_KINDS] = {};
+    EarningsRing<60> minutes{60};
+    EarningsRing<7 * 24> hours{3600};
+
+public:
+    void add(Cents fare, RideKind kind, int64_t atSeconds) {
+        const auto k = static_cast<size_t>(kind);
+        totalCents.fetch_add(fare, std::memory_order_relaxed);
+        totalCount.fetch_add(1, std::memory_order_relaxed);
+        kindCents[k].fetch_add(fare, std::memory_order_relaxed);
+        kindCount[k].fetch_add(1, std::memory_order_relaxed);
+        minutes.add(atSeconds, fare);
+        hours.add(atSeconds, fare);
+    }
+
+    Cents total() const { return totalCents.load(std::memory_order_relaxed); }
+    uint64_t count() const { return totalCount.load(std::memory_order_relaxed); }
+    Cents total(RideKind kind) const { return kindCents[static_cast<size_t>(kind)].load(std::memory_order_relaxed); }
+    uint64_t count(RideKind kind) const { return kindCount[static_cast<size_t>(kind)].load(std::memory_order_relaxed); }
+
+    Cents window(EarningsWindow w, int64_t nowSecs) const {
+        switch (w) {
+        case EarningsWindow::Hour: return minutes.sum(nowSecs, 60);
+        case EarningsWindow::Day: return hours.sum(nowSecs, 24);
+        case EarningsWindow::Week: return hours.sum(nowSecs, 7 * 24);
+        }
+        return 0;
     }
-    string rideType() const override { return "Premium"; }
 };
 
 // ----------------------------- Driver (Encapsulation) -----------------------------
+// addRide() and requestRide() may be called from many threads at once and
+// readers never block them. The fare is captured at append time, so readers
+// never touch the RideStore; producers using the RideIndex-only overload must
+// not race with RideStore::add (ingest the batch first, or pass the fare
+// explicitly). Earnings queries read the running aggregates; getDriverInfo()
+// totals the ledger snapshot it prints, so its list and total always agree.
 class Driver {
     string driverID;
     string name;
     double rating; // 1..5
     // Encapsulation: keep the list private; expose behavior, not representation
-    vector<shared_ptr<Ride>> assignedRides;
+    struct AssignedRide {
+        RideIndex ride;
+        Cents fare;
+    };
+    RideStore* rides;
+    ConcurrentLedger<AssignedRide> assignedRides;
+    EarningsAggregates earned;
 
 public:
-    Driver(string id, string n, double r)
-        : driverID(std::move(id)), name(std::move(n)), rating(r) {}
+    Driver(string id, string n, double r, RideStore& store)
+        : driverID(std::move(id)), name(std::move(n)), rating(r), rides(&store) {}
+
+    const string& id() const { return driverID; }
+    double getRating() const { return rating; }
+
+    void addRide(RideIndex ride, double fare, RideKind kind, int64_t atSeconds) {
+        const Cents cents = toCents(fare);
+        assignedRides.append({ride, cents});
+        earned.add(cents, kind, atSeconds);
+    }
+
+    // Earnings from rides outside the current RideStore batch (e.g. loaded
+    // from a trip log): counted in the aggregates, not listed in statements.
+    void recordHistory(double fare, RideKind kind, int64_t atSeconds) {
+        earned.add(toCents(fare), kind, atSeconds);
+    }
 
+    void addRide(RideIndex ride, int64_t atSeconds = nowSeconds()) {
+        addRide(ride, rides->fare(ride), rides->kind(ride), atSeconds);
+    }
+
+    // Adapter for callers holding Ride objects: the ride is ingested into the
+    // store, so this one is not safe to call concurrently.
     void addRide(const shared_ptr<Ride>& ride) {
-        assignedRides.push_back(ride);
+        addRide(rides->add(*ride));
     }
 
-    double totalEarnings() const {
-        double sum = 0.0;
-        for (const auto& r : assignedRides) sum += r->fare();
-        return sum;
+    double totalEarnings() const { return earned.total() / 100.0; }
+    double earnings(RideKind kind) const { return earned.total(kind) / 100.0; }
+    double earnings(EarningsWindow w, int64_t nowSecs = nowSeconds()) const {
+        return earned.window(w, nowSecs) / 100.0;
+    }
+    uint64_t rideCount() const { return earned.count(); }
+    uint64_t rideCount(RideKind kind) const { return earned.count(kind); }
+
+    void getDriverInfo(ReportBuffer& out) const {
+        const size_t n = assignedRides.published();
+        Cents listed = 0;
+        out.put("Driver ").put(name).put(" (").put(driverID).put(")")
+           .put(" | rating: ").decimal(rating).put('\n');
+        out.put("Assigned rides:\n");
+        assignedRides.forEach(n, [&](const AssignedRide& a) {
+            listed += a.fare;
+            out.put("  - ");
+            rides->rideDetails(a.ride, out);
+            out.put('\n');
+        });
+        out.put("Total earnings: $").decimal(listed / 100.0).put('\n');
     }
 
     void getDriverInfo(std::ostream& os) const {
-        os << "Driver " << name << " (" << driverID << ")"
-           << " | rating: " << fixed << setprecision(2) << rating << "\n";
-        os << "Assigned rides:\n";
-        for (const auto& r : assignedRides) {
-            os << "  - ";
-            r->rideDetails(os);
-            os << "\n";
-        }
-        os << "Total earnings: $" << fixed << setprecision(2) << totalEarnings() << "\n";
+        auto& out = scratchReport();
+        getDriverInfo(out);
+        out.flush(os);
     }
 };
 
@@ -115,26 +823,913 @@ public:
 class Rider {
     string riderID;
     string name;
-    vector<shared_ptr<Ride>> requestedRides;
+    RideStore* rides;
+    ConcurrentLedger<RideIndex> requestedRides;
 
 public:
-    Rider(string id, string n) : riderID(std::move(id)), name(std::move(n)) {}
+    Rider(string id, string n, RideStore& store)
+        : riderID(std::move(id)), name(std::move(n)), rides(&store) {}
+
+    const string& id() const { return riderID; }
+
+    void requestRide(RideIndex ride) {
+        requestedRides.append(ride);
+    }
 
     void requestRide(const shared_ptr<Ride>& ride) {
-        requestedRides.push_back(ride);
+        requestRide(rides->add(*ride));
+    }
+
+    void viewRides(ReportBuffer& out) const {
+        out.put("Rider ").put(name).put(" (").put(riderID).put(") ride history:\n");
+        requestedRides.forEach(requestedRides.published(), [&](RideIndex r) {
+            out.put("  - ");
+            rides->rideDetails(r, out);
+            out.put('\n');
+        });
     }
 
     void viewRides(std::ostream& os) const {
-        os << "Rider " << name << " (" << riderID << ") ride history:\n";
-        for (const auto& r : requestedRides) {
-            os << "  - ";
-            r->rideDetails(os);
-            os << "\n";
+        auto& out = scratchReport();
+        viewRides(out);
+        out.flush(os);
+    }
+};
+
+namespace pricing_detail {
+template <typename... T>
+shared_ptr<Ride> materialize(TierList<T...>, RideKind kind, string id, string pickup, string dropoff,
+                             double miles, double surge) {
+    shared_ptr<Ride> out;
+    (void)((kind == T::kind
+                ? (out = make_shared<TierRide<T>>(std::move(id), std::move(pickup), std::move(dropoff), miles, surge),
+                   true)
+                : false) ||
+           ...);
+    return out;
+}
+} // namespace pricing_detail
+
+shared_ptr<Ride> RideStore::materialize(RideIndex i) const {
+    return pricing_detail::materialize(RideTiers{}, kinds[i], string(rideIDs[i]), string(pickup(i)),
+                                       string(dropoff(i)), distances[i], surges[i]);
+}
+
+// ----------------------------- Dispatch (spatial matching) -----------------------------
+struct GeoPoint {
+    double lat;
+    double lon;
+};
+
+using DriverSlot = uint32_t;
+
+struct DriverCandidate {
+    DriverSlot slot;
+    double miles;
+};
+
+struct RideRequest {
+    RideIndex ride;
+    GeoPoint pickup;
+    double minRating = 0.0;
+};
+
+struct DispatchMatch {
+    size_t request;     // index into the tick's request list
+    DriverSlot driver;
+    double miles;
+};
+
+// Nearest-available-driver lookup over a uniform grid. Positions are projected
+// onto a local plane around `origin` (equirectangular, fine at city scale) and
+// bucketed into square cells of `cellMiles`; only available drivers sit in a
+// cell, so queries never walk past busy ones. A k-nearest query scans rings of
+// cells outward and stops once the next ring cannot beat the current k-th best.
+class Dispatcher {
+    static constexpr double MILES_PER_DEG_LAT = 69.0;
+
+    GeoPoint origin;
+    double cellMiles;
+    double milesPerDegLon;
+
+    // Per-driver columns, indexed by DriverSlot.
+    vector<Driver*> drivers;
+    vector<double> xs, ys;      // projected position, miles
+    vector<double> ratings;
+    vector<uint64_t> cellOf;
+    vector<uint32_t> posInCell; // index in cells[cellOf[slot]] while available
+    vector<uint8_t> available;
+
+    unordered_map<uint64_t, vector<DriverSlot>> cells;
+
+    static uint64_t cellKey(int32_t cx, int32_t cy) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cy);
+    }
+
+    int32_t cellCoord(double v) const { return static_cast<int32_t>(std::floor(v / cellMiles)); }
+
+    void project(GeoPoint p, double& x, double& y) const {
+        x = (p.lon - origin.lon) * milesPerDegLon;
+        y = (p.lat - origin.lat) * MILES_PER_DEG_LAT;
+    }
+
+    void link(DriverSlot slot) {
+        auto& members = cells[cellOf[slot]];
+        posInCell[slot] = static_cast<uint32_t>(members.size());
+        members.push_back(slot);
+    }
+
+    void unlink(DriverSlot slot) {
+        auto& members = cells[cellOf[slot]];
+        const DriverSlot last = members.back();
+        members[posInCell[slot]] = last;
+        posInCell[last] = posInCell[slot];
+        members.pop_back();
+    }
+
+    static bool closer(const DriverCandidate& a, const DriverCandidate& b) {
+        return a.miles < b.miles || (a.miles == b.miles && a.slot < b.slot);
+    }
+
+public:
+    explicit Dispatcher(GeoPoint center, double cellSizeMiles = 0.25)
+        : origin(center), cellMiles(cellSizeMiles),
+          milesPerDegLon(MILES_PER_DEG_LAT * std::cos(center.lat * 3.14159265358979323846 / 180.0)) {}
+
+    DriverSlot addDriver(Driver& driver, GeoPoint at) {
+        const auto slot = static_cast<DriverSlot>(drivers.size());
+        double x, y;
+        project(at, x, y);
+        drivers.push_back(&driver);
+        xs.push_back(x);
+        ys.push_back(y);
+        ratings.push_back(driver.getRating());
+        cellOf.push_back(cellKey(cellCoord(x), cellCoord(y)));
+        posInCell.push_back(0);
+        available.push_back(1);
+        link(slot);
+        return slot;
+    }
+
+    void moveDriver(DriverSlot slot, GeoPoint to) {
+        double x, y;
+        project(to, x, y);
+        xs[slot] = x;
+        ys[slot] = y;
+        const uint64_t key = cellKey(cellCoord(x), cellCoord(y));
+        if (key == cellOf[slot]) return;
+        if (available[slot]) unlink(slot);
+        cellOf[slot] = key;
+        if (available[slot]) link(slot);
+    }
+
+    void setAvailable(DriverSlot slot, bool on) {
+        if (available[slot] == on) return;
+        available[slot] = on;
+        if (on) link(slot);
+        else unlink(slot);
+    }
+
+    bool isAvailable(DriverSlot slot) const { return available[slot] != 0; }
+    Driver& driver(DriverSlot slot) const { return *drivers[slot]; }
+    size_t size() const { return drivers.size(); }
+
+    // Up to k available drivers rated at least `minRating` within `maxMiles`,
+    // nearest first (ties by slot).
+    void nearest(GeoPoint at, size_t k, double minRating, double maxMiles,
+                 vector<DriverCandidate>& out) const {
+        out.clear();
+        if (k == 0) return;
+        double x, y;
+        project(at, x, y);
+        const int32_t cx = cellCoord(x), cy = cellCoord(y);
+        const int32_t maxRing = static_cast<int32_t>(std::ceil(maxMiles / cellMiles)) + 1;
+
+        // `out` is a max-heap on distance while scanning.
+        auto visit = [&](int32_t gx, int32_t gy) {
+            auto it = cells.find(cellKey(gx, gy));
+            if (it == cells.end()) return;
+            for (DriverSlot s : it->second) {
+                if (ratings[s] < minRating) continue;
+                const DriverCandidate c{s, std::hypot(xs[s] - x, ys[s] - y)};
+                if (c.miles > maxMiles) continue;
+                if (out.size() < k) {
+                    out.push_back(c);
+                    std::push_heap(out.begin(), out.end(), closer);
+                } else if (closer(c, out.front())) {
+                    std::pop_heap(out.begin(), out.end(), closer);
+                    out.back() = c;
+                    std::push_heap(out.begin(), out.end(), closer);
+                }
+            }
+        };
+
+        for (int32_t r = 0; r <= maxRing; ++r) {
+            // Every point in ring r is at least (r - 1) cells away from the query.
+            if (out.size() == k && (r - 1) * cellMiles > out.front().miles) break;
+            if (r == 0) {
+                visit(cx, cy);
+                continue;
+            }
+            for (int32_t d = -r; d <= r; ++d) {
+                visit(cx + d, cy - r);
+                visit(cx + d, cy + r);
+            }
+            for (int32_t d = -r + 1; d <= r - 1; ++d) {
+                visit(cx - r, cy + d);
+                visit(cx + r, cy + d);
+            }
+        }
+        std::sort_heap(out.begin(), out.end(), closer);
+    }
+
+    // One dispatch tick: every request proposes its `candidatesPerRequest`
+    // nearest eligible drivers, then the pooled pairs are taken shortest-first
+    // so neighbouring requests don't race for the same driver in arrival order.
+    // Matched drivers get the ride and leave the available pool.
+    vector<DispatchMatch> matchTick(const vector<RideRequest>& requests,
+                                    size_t candidatesPerRequest = 4, double maxMiles = 5.0) {
+        vector<DispatchMatch> pairs;
+        vector<DriverCandidate> found;
+        for (size_t q = 0; q < requests.size(); ++q) {
+            nearest(requests[q].pickup, candidatesPerRequest, requests[q].minRating, maxMiles, found);
+            for (const auto& c : found) pairs.push_back({q, c.slot, c.miles});
+        }
+        std::sort(pairs.begin(), pairs.end(), [](const DispatchMatch& a, const DispatchMatch& b) {
+            if (a.miles != b.miles) return a.miles < b.miles;
+            if (a.request != b.request) return a.request < b.request;
+            return a.driver < b.driver;
+        });
+
+        vector<uint8_t> served(requests.size(), 0);
+        vector<DispatchMatch> matches;
+        for (const auto& p : pairs) {
+            if (served[p.request] || !available[p.driver]) continue;
+            served[p.request] = 1;
+            setAvailable(p.driver, false);
+            drivers[p.driver]->addRide(requests[p.request].ride);
+            matches.push_back(p);
+        }
+        return matches;
+    }
+};
+
+// ----------------------------- Surge engine -----------------------------
+// Live demand multipliers per pickup zone (dense ZoneIds, e.g. LocationIds).
+//
+// The request path only bumps counters: recordRequest()/recordAvailable() are
+// one CAS on a per-zone ring of time buckets. A timer thread (start()) runs
+// tick() every interval, turns the trailing window of each zone into a
+// multiplier and publishes the whole table at once by swapping a pointer, so
+// multiplier() is a load and an index. Supply is counted in driver pings: each
+// available driver is expected to report once per bucket.
+//
+// Tables are recycled through a small ring instead of being freed, so a reader
+// must not hold the pointer behind multiplier() across ticks; take copies for
+// anything longer-lived.
+using ZoneId = uint32_t;
+
+struct SurgeConfig {
+    int64_t bucketMs = 5000;
+    size_t buckets = 12;        // window = buckets * bucketMs
+    double sensitivity = 0.5;   // multiplier gained per unit of demand/supply above 1
+    double maxSurge = 3.0;
+    double step = 0.05;         // published multipliers are multiples of this
+};
+
+class SurgeEngine {
+    static constexpr size_t TABLES = 3;
+
+    SurgeConfig cfg;
+    size_t zones;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    // Bucket word: absolute bucket number (high 32 bits) | count (low 32 bits).
+    std::unique_ptr<std::atomic<uint64_t>[]> demand, supply;
+
+    std::array<vector<double>, TABLES> tables;
+    std::atomic<const double*> published;
+    size_t nextTable = 1;
+
+    std::thread timer;
+    std::mutex timerMu;
+    std::condition_variable timerCv;
+    bool stopping = false;
+
+    static void bump(std::atomic<uint64_t>& slot, uint64_t bucket) {
+        uint64_t cur = slot.load(std::memory_order_relaxed);
+        for (;;) {
+            const uint64_t curBucket = cur >> 32;
+            if (curBucket > bucket) return; // too old for the window
+            const uint64_t count = curBucket == bucket ? (cur & 0xffffffffu) + 1 : 1;
+            if (slot.compare_exchange_weak(cur, (bucket << 32) | count, std::memory_order_relaxed)) return;
+        }
+    }
+
+    uint64_t windowSum(const std::atomic<uint64_t>* ring, uint64_t last) const {
+        uint64_t total = 0;
+        for (size_t b = 0; b < cfg.buckets && b <= last; ++b) {
+            const uint64_t want = last - b;
+            const uint64_t v = ring[want % cfg.buckets].load(std::memory_order_relaxed);
+            if ((v >> 32) == want) total += v & 0xffffffffu;
+        }
+        return total;
+    }
+
+    uint64_t bucketAt(int64_t nowMs) const { return static_cast<uint64_t>(std::max<int64_t>(nowMs, 0) / cfg.bucketMs); }
+
+public:
+    SurgeEngine(size_t zoneCount, SurgeConfig config = {})
+        : cfg(config), zones(zoneCount),
+          demand(new std::atomic<uint64_t>[zoneCount * config.buckets]),
+          supply(new std::atomic<uint64_t>[zoneCount * config.buckets]) {
+        if (cfg.bucketMs <= 0 || cfg.buckets == 0 || cfg.step <= 0.0) {
+            throw std::invalid_argument("SurgeEngine: bucketMs, buckets and step must be positive");
+        }
+        for (size_t i = 0; i < zones * cfg.buckets; ++i) {
+            demand[i].store(0, std::memory_order_relaxed);
+            supply[i].store(0, std::memory_order_relaxed);
+        }
+        for (auto& t : tables) t.assign(zones, 1.0);
+        published.store(tables[0].data(), std::memory_order_release);
+    }
+
+    ~SurgeEngine() { stop(); }
+
+    SurgeEngine(const SurgeEngine&) = delete;
+    SurgeEngine& operator=(const SurgeEngine&) = delete;
+
+    // Milliseconds since the engine was created; the clock every default argument uses.
+    int64_t nowMs() const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    void recordRequest(ZoneId zone) { recordRequest(zone, nowMs()); }
+    void recordRequest(ZoneId zone, int64_t atMs) {
+        const uint64_t b = bucketAt(atMs);
+        bump(demand[zone * cfg.buckets + b % cfg.buckets], b);
+    }
+
+    void recordAvailable(ZoneId zone) { recordAvailable(zone, nowMs()); }
+    void recordAvailable(ZoneId zone, int64_t atMs) {
+        const uint64_t b = bucketAt(atMs);
+        bump(supply[zone * cfg.buckets + b % cfg.buckets], b);
+    }
+
+    // Latest published multiplier for `zone` (1.0 before the first tick).
+    double multiplier(ZoneId zone) const { return published.load(std::memory_order_acquire)[zone]; }
+
+    // Recomputes and publishes every zone's multiplier from the trailing window.
+    // Called by the timer thread; safe to call directly when no timer runs.
+    void tick(int64_t atMs) {
+        vector<double>& next = tables[nextTable];
+        const uint64_t last = bucketAt(atMs);
+        for (size_t z = 0; z < zones; ++z) {
+            const double requests = static_cast<double>(windowSum(&demand[z * cfg.buckets], last));
+            const double pings = static_cast<double>(windowSum(&supply[z * cfg.buckets], last));
+            const double drivers = std::max(1.0, pings / static_cast<double>(cfg.buckets));
+            const double raw = 1.0 + cfg.sensitivity * (requests / drivers - 1.0);
+            const double clamped = std::min(cfg.maxSurge, std::max(1.0, raw));
+            next[z] = std::round(clamped / cfg.step) * cfg.step;
+        }
+        published.store(next.data(), std::memory_order_release);
+        nextTable = (nextTable + 1) % TABLES;
+    }
+    void tick() { tick(nowMs()); }
+
+    // Runs tick() every `interval` on a background thread until stop().
+    void start(std::chrono::milliseconds interval) {
+        stop();
+        stopping = false;
+        timer = std::thread([this, interval] {
+            std::unique_lock<std::mutex> lock(timerMu);
+            while (!timerCv.wait_for(lock, interval, [this] { return stopping; })) tick();
+        });
+    }
+
+    void stop() {
+        if (!timer.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(timerMu);
+            stopping = true;
+        }
+        timerCv.notify_all();
+        timer.join();
+    }
+
+    size_t zoneCount() const { return zones; }
+};
+
+// A tier ride priced at the zone's live multiplier (shaped by the tier's surge model).
+template <typename Tier>
+shared_ptr<TierRide<Tier>> makeSurgedRide(const SurgeEngine& surge, ZoneId zone, string id, string pickup,
+                                          string dropoff, double miles, int hourOfDay) {
+    return make_shared<TierRide<Tier>>(std::move(id), std::move(pickup), std::move(dropoff), miles,
+                                       tierSurge(Tier::kind, surge.multiplier(zone), hourOfDay));
+}
+
+// ----------------------------- Trip log (columnar, mmap) -----------------------------
+// On-disk history: one file per period (e.g. a month), written once, mapped read-only.
+//
+//   TripLogHeader | sections, each 64-byte aligned and addressed by header offset
+//
+// Fixed-width columns (miles, surge, startedAt, kind, pickup, dropoff, driver,
+// rider) are raw arrays in host byte order, so the reader hands out pointers
+// straight into the mapping and the fare kernel runs on them in place. Ride IDs
+// and the three dictionaries (locations, drivers, riders) are string columns: a
+// count, count+1 byte offsets, then the bytes. Every `blockRows` rows get a
+// TripBlockStats entry with per-block ranges, so scans can skip whole blocks.
+constexpr uint32_t TRIP_LOG_VERSION = 1;
+constexpr uint32_t NO_OWNER = UINT32_MAX; // driver/rider column value when unknown
+
+struct TripLogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t blockRows;
+    uint64_t rows;
+    uint64_t blocks;
+    uint64_t miles, surge, startedAt, kind, pickup, dropoff, driver, rider;
+    uint64_t blockStats;
+    uint64_t rideIDs, locations, drivers, riders;
+};
+
+struct TripBlockStats {
+    double minMiles, maxMiles;
+    double minSurge, maxSurge;
+    int64_t minStartedAt, maxStartedAt;
+    uint32_t kindMask; // bit k set if the block holds a ride of RideKind k
+    uint32_t reserved;
+};
+
+inline constexpr char TRIP_LOG_MAGIC[8] = {'R', 'I', 'D', 'E', 'L', 'O', 'G', '\0'};
+
+// Per-ride context the RideStore does not keep, parallel to its indices.
+// Any vector may be left empty: owners are then NO_OWNER and times 0.
+struct TripOwners {
+    vector<std::string_view> driver;
+    vector<std::string_view> rider;
+    vector<int64_t> startedAt;
+};
+
+namespace triplog_detail {
+
+class Writer {
+    vector<char> bytes;
+
+public:
+    Writer() { bytes.resize(sizeof(TripLogHeader)); }
+
+    uint64_t align() {
+        bytes.resize((bytes.size() + 63) & ~size_t{63});
+        return bytes.size();
+    }
+
+    template <typename T, typename F>
+    uint64_t column(size_t n, F&& at) {
+        const uint64_t off = align();
+        bytes.resize(off + n * sizeof(T));
+        for (size_t i = 0; i < n; ++i) {
+            const T v = at(i);
+            std::memcpy(bytes.data() + off + i * sizeof(T), &v, sizeof(T));
+        }
+        return off;
+    }
+
+    template <typename F>
+    uint64_t strings(size_t n, F&& at) {
+        const uint64_t off = align();
+        const uint64_t count = n;
+        vector<uint64_t> offsets(n + 1, 0);
+        for (size_t i = 0; i < n; ++i) offsets[i + 1] = offsets[i] + at(i).size();
+        append(&count, sizeof count);
+        append(offsets.data(), offsets.size() * sizeof(uint64_t));
+        for (size_t i = 0; i < n; ++i) append(at(i).data(), at(i).size());
+        return off;
+    }
+
+    void append(const void* p, size_t n) {
+        const size_t at = bytes.size();
+        bytes.resize(at + n);
+        if (n) std::memcpy(bytes.data() + at, p, n);
+    }
+
+    vector<char>& data() { return bytes; }
+};
+
+// Dictionary encoder for driver/rider names.
+struct Dictionary {
+    vector<std::string_view> names;
+    unordered_map<std::string_view, uint32_t> ids;
+
+    uint32_t code(std::string_view s) {
+        auto [it, fresh] = ids.emplace(s, static_cast<uint32_t>(names.size()));
+        if (fresh) names.push_back(s);
+        return it->second;
+    }
+};
+
+} // namespace triplog_detail
+
+inline void writeTripLog(const string& path, const RideStore& store, const TripOwners& owners = {},
+                         uint32_t blockRows = 4096) {
+    using triplog_detail::Dictionary;
+    const size_t n = store.size();
+    auto check = [&](size_t got, const char* what) {
+        if (got != 0 && got != n) {
+            throw std::invalid_argument(string("writeTripLog: ") + what + " column does not match the store");
+        }
+    };
+    check(owners.driver.size(), "driver");
+    check(owners.rider.size(), "rider");
+    check(owners.startedAt.size(), "startedAt");
+    if (blockRows == 0) throw std::invalid_argument("writeTripLog: blockRows must be positive");
+
+    Dictionary drivers, riders;
+    vector<uint32_t> driverCol(n, NO_OWNER), riderCol(n, NO_OWNER);
+    for (size_t i = 0; i < owners.driver.size(); ++i) driverCol[i] = drivers.code(owners.driver[i]);
+    for (size_t i = 0; i < owners.rider.size(); ++i) riderCol[i] = riders.code(owners.rider[i]);
+    auto startedAt = [&](size_t i) { return owners.startedAt.empty() ? int64_t{0} : owners.startedAt[i]; };
+
+    triplog_detail::Writer w;
+    TripLogHeader h{};
+    std::memcpy(h.magic, TRIP_LOG_MAGIC, sizeof h.magic);
+    h.version = TRIP_LOG_VERSION;
+    h.blockRows = blockRows;
+    h.rows = n;
+    h.blocks = (n + blockRows - 1) / blockRows;
+
+    const auto idx = [](size_t i) { return static_cast<RideIndex>(i); };
+    h.miles = w.column<double>(n, [&](size_t i) { return store.miles(idx(i)); });
+    h.surge = w.column<double>(n, [&](size_t i) { return store.surge(idx(i)); });
+    h.startedAt = w.column<int64_t>(n, startedAt);
+    h.kind = w.column<RideKind>(n, [&](size_t i) { return store.kind(idx(i)); });
+    h.pickup = w.column<LocationId>(n, [&](size_t i) { return store.pickupID(idx(i)); });
+    h.dropoff = w.column<LocationId>(n, [&](size_t i) { return store.dropoffID(idx(i)); });
+    h.driver = w.column<uint32_t>(n, [&](size_t i) { return driverCol[i]; });
+    h.rider = w.column<uint32_t>(n, [&](size_t i) { return riderCol[i]; });
+
+    h.blockStats = w.column<TripBlockStats>(h.blocks, [&](size_t b) {
+        const size_t begin = b * blockRows, end = std::min(n, begin + blockRows);
+        TripBlockStats s{};
+        s.minMiles = s.minSurge = std::numeric_limits<double>::infinity();
+        s.maxMiles = s.maxSurge = -std::numeric_limits<double>::infinity();
+        s.minStartedAt = std::numeric_limits<int64_t>::max();
+        s.maxStartedAt = std::numeric_limits<int64_t>::min();
+        for (size_t i = begin; i < end; ++i) {
+            s.minMiles = std::min(s.minMiles, store.miles(idx(i)));
+            s.maxMiles = std::max(s.maxMiles, store.miles(idx(i)));
+            s.minSurge = std::min(s.minSurge, store.surge(idx(i)));
+            s.maxSurge = std::max(s.maxSurge, store.surge(idx(i)));
+            s.minStartedAt = std::min(s.minStartedAt, startedAt(i));
+            s.maxStartedAt = std::max(s.maxStartedAt, startedAt(i));
+            s.kindMask |= 1u << static_cast<unsigned>(store.kind(idx(i)));
         }
+        return s;
+    });
+
+    const LocationTable& locations = store.locationTable();
+    h.rideIDs = w.strings(n, [&](size_t i) { return store.id(idx(i)); });
+    h.locations = w.strings(locations.size(), [&](size_t i) { return locations.name(static_cast<LocationId>(i)); });
+    h.drivers = w.strings(drivers.names.size(), [&](size_t i) { return drivers.names[i]; });
+    h.riders = w.strings(riders.names.size(), [&](size_t i) { return riders.names[i]; });
+
+    auto& bytes = w.data();
+    std::memcpy(bytes.data(), &h, sizeof h);
+
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) throw std::runtime_error("Cannot create " + path + ": " + std::strerror(errno));
+    const bool ok = std::fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+    if (std::fclose(f) != 0 || !ok) throw std::runtime_error("Cannot write " + path);
+}
+
+// Read-only view of a trip log. Construction maps the file and validates the
+// header, the string tables and every code column (one pass, nothing copied),
+// so the accessors can trust the mapping. All pointers and string_views stay
+// valid for the TripLog's lifetime.
+class TripLog {
+    const char* base = nullptr;
+    size_t length = 0;
+    TripLogHeader h{};
+
+    struct Strings {
+        uint64_t count = 0;
+        const uint64_t* offsets = nullptr;
+        const char* bytes = nullptr;
+
+        std::string_view at(size_t i) const {
+            return {bytes + offsets[i], static_cast<size_t>(offsets[i + 1] - offsets[i])};
+        }
+    };
+    Strings ids, locationNames, driverNames, riderNames;
+
+    [[noreturn]] static void corrupt(const string& path, const char* why) {
+        throw std::runtime_error(path + ": not a valid trip log (" + why + ")");
+    }
+
+    template <typename T>
+    const T* column(uint64_t off, uint64_t count, const string& path) const {
+        if (off % 64 != 0 || off > length || count > (length - off) / sizeof(T)) corrupt(path, "column out of range");
+        return reinterpret_cast<const T*>(base + off);
+    }
+
+    Strings strings(uint64_t off, const string& path) const {
+        Strings s;
+        if (off % 64 != 0 || off > length || length - off < sizeof(uint64_t)) corrupt(path, "strings out of range");
+        std::memcpy(&s.count, base + off, sizeof s.count);
+        const uint64_t words = (length - off) / sizeof(uint64_t);
+        if (words < 2 || s.count > words - 2) corrupt(path, "strings out of range");
+        s.offsets = column<uint64_t>(off, s.count + 2, path) + 1;
+        s.bytes = reinterpret_cast<const char*>(s.offsets + s.count + 1);
+        const uint64_t blob = static_cast<uint64_t>(base + length - s.bytes);
+        for (uint64_t i = 0; i < s.count; ++i) {
+            if (s.offsets[i] > s.offsets[i + 1]) corrupt(path, "string offsets not increasing");
+        }
+        if (s.offsets[0] != 0 || s.offsets[s.count] > blob) corrupt(path, "strings truncated");
+        return s;
+    }
+
+    // Every code in `col` must index a table of `limit` entries, or be NO_OWNER
+    // where `ownerColumn` allows it. Branch-free, so the scan runs at memory speed.
+    template <typename T>
+    static void checkCodes(const T* col, uint64_t rows, uint64_t limit, bool ownerColumn, const string& path,
+                           const char* why) {
+        bool bad = false;
+        for (uint64_t i = 0; i < rows; ++i) {
+            bad |= col[i] >= limit && !(ownerColumn && col[i] == NO_OWNER);
+        }
+        if (bad) corrupt(path, why);
+    }
+
+public:
+    explicit TripLog(const string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            const int err = errno;
+            ::close(fd);
+            throw std::runtime_error("Cannot stat " + path + ": " + std::strerror(err));
+        }
+        length = static_cast<size_t>(st.st_size);
+        if (length < sizeof h) {
+            ::close(fd);
+            corrupt(path, "too short");
+        }
+        void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) throw std::runtime_error("Cannot map " + path + ": " + std::strerror(errno));
+        base = static_cast<const char*>(p);
+
+        try {
+            std::memcpy(&h, base, sizeof h);
+            if (std::memcmp(h.magic, TRIP_LOG_MAGIC, sizeof h.magic) != 0) corrupt(path, "bad magic");
+            if (h.version != TRIP_LOG_VERSION) corrupt(path, "unsupported version");
+            if (h.blockRows == 0 || h.blocks != (h.rows + h.blockRows - 1) / h.blockRows) corrupt(path, "bad block count");
+            column<double>(h.miles, h.rows, path);
+            column<double>(h.surge, h.rows, path);
+            column<int64_t>(h.startedAt, h.rows, path);
+            column<RideKind>(h.kind, h.rows, path);
+            column<LocationId>(h.pickup, h.rows, path);
+            column<LocationId>(h.dropoff, h.rows, path);
+            column<uint32_t>(h.driver, h.rows, path);
+            column<uint32_t>(h.rider, h.rows, path);
+            column<TripBlockStats>(h.blockStats, h.blocks, path);
+            ids = strings(h.rideIDs, path);
+            locationNames = strings(h.locations, path);
+            driverNames = strings(h.drivers, path);
+            riderNames = strings(h.riders, path);
+            if (ids.count != h.rows) corrupt(path, "ride ID count");
+
+            static_assert(sizeof(RideKind) == sizeof(uint8_t), "kind column is one byte per ride");
+            checkCodes(column<uint8_t>(h.kind, h.rows, path), h.rows, NUM_RIDE_KINDS, false, path, "unknown ride kind");
+            checkCodes(pickups(), h.rows, locationNames.count, false, path, "pickup outside the location table");
+            checkCodes(dropoffs(), h.rows, locationNames.count, false, path, "dropoff outside the location table");
+            checkCodes(drivers(), h.rows, driverNames.count, true, path, "driver outside the driver table");
+            checkCodes(riders(), h.rows, riderNames.count, true, path, "rider outside the rider table");
+        } catch (...) {
+            ::munmap(const_cast<char*>(base), length);
+            throw;
+        }
+    }
+
+    ~TripLog() { ::munmap(const_cast<char*>(base), length); }
+
+    TripLog(const TripLog&) = delete;
+    TripLog& operator=(const TripLog&) = delete;
+
+    size_t size() const { return h.rows; }
+    size_t blockRows() const { return h.blockRows; }
+    size_t blockCount() const { return h.blocks; }
+
+    const double* miles() const { return reinterpret_cast<const double*>(base + h.miles); }
+    const double* surges() const { return reinterpret_cast<const double*>(base + h.surge); }
+    const int64_t* startedAt() const { return reinterpret_cast<const int64_t*>(base + h.startedAt); }
+    const RideKind* kinds() const { return reinterpret_cast<const RideKind*>(base + h.kind); }
+    const LocationId* pickups() const { return reinterpret_cast<const LocationId*>(base + h.pickup); }
+    const LocationId* dropoffs() const { return reinterpret_cast<const LocationId*>(base + h.dropoff); }
+    const uint32_t* drivers() const { return reinterpret_cast<const uint32_t*>(base + h.driver); }
+    const uint32_t* riders() const { return reinterpret_cast<const uint32_t*>(base + h.rider); }
+    const TripBlockStats* blocks() const { return reinterpret_cast<const TripBlockStats*>(base + h.blockStats); }
+
+    std::string_view rideID(size_t i) const { return ids.at(i); }
+    std::string_view location(LocationId id) const { return locationNames.at(id); }
+    size_t locationCount() const { return locationNames.count; }
+    std::string_view driverName(uint32_t code) const { return driverNames.at(code); }
+    size_t driverCount() const { return driverNames.count; }
+    std::string_view riderName(uint32_t code) const { return riderNames.at(code); }
+    size_t riderCount() const { return riderNames.count; }
+
+    // Fares for rows [begin, end) into out[0 .. end-begin), straight off the mapping.
+    void computeFares(size_t begin, size_t end, double* out) const {
+        ::computeFares(miles() + begin, surges() + begin, kinds() + begin, out, end - begin);
+    }
+
+    // Calls f(begin, end) for each block that may hold a ride started in
+    // [from, to); blocks entirely outside the range are skipped unread.
+    template <typename F>
+    void forEachBlockStarted(int64_t from, int64_t to, F&& f) const {
+        const TripBlockStats* stats = blocks();
+        for (size_t b = 0; b < h.blocks; ++b) {
+            if (stats[b].maxStartedAt < from || stats[b].minStartedAt >= to) continue;
+            f(b * h.blockRows, std::min<size_t>(h.rows, (b + 1) * h.blockRows));
+        }
+    }
+
+    // Credits every ride to its driver's earnings aggregates, one block of
+    // fares at a time. `byDriverCode[c]` is the Driver for driverName(c), or
+    // null to skip that driver.
+    void creditDrivers(const vector<Driver*>& byDriverCode) const {
+        vector<double> fares(h.blockRows);
+        const uint32_t* owner = drivers();
+        for (size_t begin = 0; begin < h.rows; begin += h.blockRows) {
+            const size_t end = std::min<size_t>(h.rows, begin + h.blockRows);
+            computeFares(begin, end, fares.data());
+            for (size_t i = begin; i < end; ++i) {
+                if (owner[i] == NO_OWNER || owner[i] >= byDriverCode.size() || !byDriverCode[owner[i]]) continue;
+                byDriverCode[owner[i]]->recordHistory(fares[i - begin], kinds()[i], startedAt()[i]);
+            }
+        }
+    }
+};
+
+// ----------------------------- Registry (lookup by ID) -----------------------------
+// Drivers or riders by ID. The table is split into SHARDS by the top bits of
+// the ID hash, each shard with its own reader/writer lock, so lookups on
+// different shards never contend and lookups on the same shard share the lock.
+// Within a shard, objects live in a deque (stable addresses, contiguous
+// chunks for fleet-wide scans) and an open-addressing index of 8-byte slots
+// maps IDs to them with linear probing. Entries are never removed, so a
+// pointer returned by find() or emplace() stays valid for the registry's life.
+template <typename T>
+class ShardedRegistry {
+    static constexpr size_t SHARDS = 16;
+    static constexpr unsigned SHARD_SHIFT = 60;
+
+    struct Slot {
+        uint32_t tag;   // high half of the hash, checked before comparing IDs
+        uint32_t item;  // index + 1 into items; 0 = empty
+    };
+
+    struct Shard {
+        mutable std::shared_mutex mu;
+        std::deque<T> items;
+        vector<uint64_t> hashes; // parallel to items, for rehashing
+        vector<Slot> slots;      // power-of-two size
+
+        // Index of the item with this ID, or the empty slot where it would go.
+        size_t probe(std::string_view id, uint64_t hash) const {
+            const size_t mask = slots.size() - 1;
+            const auto tag = static_cast<uint32_t>(hash >> 32);
+            for (size_t i = hash & mask;; i = (i + 1) & mask) {
+                const Slot& s = slots[i];
+                if (s.item == 0) return i;
+                if (s.tag == tag && items[s.item - 1].id() == id) return i;
+            }
+        }
+
+        void grow(size_t want) {
+            size_t cap = slots.empty() ? 16 : slots.size();
+            while (want * 10 > cap * 7) cap *= 2;
+            if (cap == slots.size()) return;
+            vector<Slot> fresh(cap, Slot{0, 0});
+            for (size_t k = 0; k < items.size(); ++k) {
+                size_t i = hashes[k] & (cap - 1);
+                while (fresh[i].item) i = (i + 1) & (cap - 1);
+                fresh[i] = Slot{static_cast<uint32_t>(hashes[k] >> 32), static_cast<uint32_t>(k + 1)};
+            }
+            slots.swap(fresh);
+        }
+
+        template <typename... Args>
+        std::pair<T*, bool> emplace(std::string_view id, uint64_t hash, Args&&... args) {
+            grow(items.size() + 1);
+            const size_t i = probe(id, hash);
+            if (slots[i].item) return {&items[slots[i].item - 1], false};
+            items.emplace_back(string(id), std::forward<Args>(args)...);
+            hashes.push_back(hash);
+            slots[i] = Slot{static_cast<uint32_t>(hash >> 32), static_cast<uint32_t>(items.size())};
+            return {&items.back(), true};
+        }
+    };
+
+    std::array<Shard, SHARDS> shards;
+
+    static uint64_t hashOf(std::string_view id) {
+        // std::hash is fine for the low bits; fold them up so the shard bits vary too.
+        const uint64_t h = std::hash<std::string_view>{}(id);
+        return h ^ (h >> 29) ^ (h << 35);
+    }
+
+public:
+    // Inserts T(string(id), args...) unless the ID is present; returns the entry
+    // and whether it was created.
+    template <typename... Args>
+    std::pair<T*, bool> emplace(std::string_view id, Args&&... args) {
+        const uint64_t h = hashOf(id);
+        Shard& s = shards[h >> SHARD_SHIFT];
+        std::unique_lock<std::shared_mutex> lock(s.mu);
+        return s.emplace(id, h, std::forward<Args>(args)...);
+    }
+
+    T* find(std::string_view id) const {
+        const uint64_t h = hashOf(id);
+        const Shard& s = shards[h >> SHARD_SHIFT];
+        std::shared_lock<std::shared_mutex> lock(s.mu);
+        if (s.slots.empty()) return nullptr;
+        const Slot& slot = s.slots[s.probe(id, h)];
+        return slot.item ? const_cast<T*>(&s.items[slot.item - 1]) : nullptr;
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for (const auto& s : shards) {
+            std::shared_lock<std::shared_mutex> lock(s.mu);
+            n += s.items.size();
+        }
+        return n;
+    }
+
+    // Visits every entry, shard by shard in storage order (e.g. fleet payouts).
+    template <typename F>
+    void forEach(F&& f) const {
+        for (const auto& s : shards) {
+            std::shared_lock<std::shared_mutex> lock(s.mu);
+            for (const T& item : s.items) f(item);
+        }
+    }
+
+    // Registers `count` IDs in one pass: IDs are grouped by shard first, so
+    // each shard is locked and grown once. Returns the entry for every ID, in
+    // input order. `idAt(i)` gives the i-th ID; `make(i)` gives the
+    // constructor arguments after the ID as a tuple.
+    template <typename IdAt, typename Make>
+    vector<T*> bulkLoad(size_t count, IdAt&& idAt, Make&& make) {
+        vector<T*> out(count, nullptr);
+        vector<uint64_t> hash(count);
+        std::array<vector<uint32_t>, SHARDS> byShard;
+        for (size_t i = 0; i < count; ++i) {
+            hash[i] = hashOf(idAt(i));
+            byShard[hash[i] >> SHARD_SHIFT].push_back(static_cast<uint32_t>(i));
+        }
+        for (size_t k = 0; k < SHARDS; ++k) {
+            if (byShard[k].empty()) continue;
+            Shard& s = shards[k];
+            std::unique_lock<std::shared_mutex> lock(s.mu);
+            s.grow(s.items.size() + byShard[k].size());
+            for (uint32_t i : byShard[k]) {
+                out[i] = std::apply([&](auto&&... args) {
+                    return s.emplace(idAt(i), hash[i], std::forward<decltype(args)>(args)...).first;
+                }, make(i));
+            }
+        }
+        return out;
     }
 };
 
+using DriverRegistry = ShardedRegistry<Driver>;
+using RiderRegistry = ShardedRegistry<Rider>;
+
+// Registers every driver in a trip log's dictionary and credits the log's
+// earnings to them. Drivers not yet registered get a placeholder profile.
+inline vector<Driver*> loadDrivers(DriverRegistry& registry, const TripLog& log, RideStore& store,
+                                   double defaultRating = 5.0) {
+    vector<Driver*> byCode = registry.bulkLoad(
+        log.driverCount(), [&](size_t c) { return log.driverName(static_cast<uint32_t>(c)); },
+        [&](size_t c) {
+            return std::make_tuple(string(log.driverName(static_cast<uint32_t>(c))), defaultRating, std::ref(store));
+        });
+    log.creditDrivers(byCode);
+    return byCode;
+}
+
+inline vector<Rider*> loadRiders(RiderRegistry& registry, const TripLog& log, RideStore& store) {
+    return registry.bulkLoad(
+        log.riderCount(), [&](size_t c) { return log.riderName(static_cast<uint32_t>(c)); },
+        [&](size_t c) { return std::make_tuple(string(log.riderName(static_cast<uint32_t>(c))), std::ref(store)); });
+}
+
 // --------------------------------- Demo (Polymorphism) ---------------------------------
+#ifndef RIDE_SHARE_NO_MAIN
 int main() {
     // Create rides of different types
     auto r1 = make_shared<StandardRide>("R1001", "Downtown", "Airport", 15.2);
@@ -153,13 +1748,28 @@ int main() {
     }
     cout << "\n";
 
+    // Ingest once into columnar storage; Driver and Rider keep indices into it
+    RideStore store;
+    vector<RideIndex> stored;
+    for (const auto& ride : rides) stored.push_back(store.add(*ride));
+
     // Driver and Rider flows
-    Driver d1("D01", "Avery", 4.88);
-    for (const auto& ride : rides) d1.addRide(ride);
+    Driver d1("D01", "Avery", 4.88, store);
+    for (RideIndex ride : stored) d1.addRide(ride);
     d1.getDriverInfo(cout);
     cout << "\n";
 
-    Rider u1("U01", "Sebastian");
-    for (const auto& ride : rides) u1.requestRide(ride);
+    Rider u1("U01", "Sebastian", store);
+    for (RideIndex ride : stored) u1.requestRide(ride);
     u1.viewRides(cout);
     cout << "\n";
+
+    return 0;
+}
+#endif
+
+#if defined(__clang__)
+#pragma float_control(pop)
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
@@ -0,0 +1,184 @@
+// Synthetic-fleet benchmark for ride_share.cpp: ns/op for each hot path.
+//
+// Build: make ride_share_bench
+// Usage: ride_share_bench [--rides 1000000] [--drivers 10000] [--riders 50000]
+//                         [common bench_harness.h options]
+//   --json / --save-baseline FILE : write one JSON line per phase to FILE
+//   --gate FILE                   : exit 2 if any phase's p50 is more than `tolerance`
+//                                   slower, or allocates more per op, than in FILE
+// Hardware counters come from perf_event_open where the kernel allows it, else "n/a".
+
+#define RIDE_SHARE_NO_MAIN
+#include "ride_share.cpp"
+
+#include "bench_harness.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+static std::atomic<size_t> g_allocs{0};
+
+// Kept out of line so GCC does not pair inlined malloc/free against new/delete callers.
+__attribute__((noinline)) void* operator new(size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+
+static size_t alloc_count() { return g_allocs.load(std::memory_order_relaxed); }
+
+struct FleetSpec {
+    size_t rides = 1000000;
+    size_t drivers = 10000;
+    size_t riders = 50000;
+    unsigned seed = 1;
+};
+
+// Synthetic trip: owner indices plus the ride's own fields.
+struct SyntheticTrip {
+    RideKind kind;
+    string id;
+    uint32_t pickup, dropoff;
+    double miles, surge;
+    uint32_t driver, rider;
+};
+
+struct SyntheticFleet {
+    vector<string> zones;
+    vector<SyntheticTrip> trips;
+};
+
+static SyntheticFleet synthetic_fleet(const FleetSpec& spec) {
+    std::mt19937 rng(spec.seed);
+    std::uniform_real_distribution<double> miles(0.5, 30.0), surge(1.0, 2.5);
+    SyntheticFleet fleet;
+    for (int z = 0; z < 256; ++z) fleet.zones.push_back("Zone-" + std::to_string(z));
+    fleet.trips.reserve(spec.rides);
+    for (size_t i = 0; i < spec.rides; ++i) {
+        SyntheticTrip t;
+        t.kind = static_cast<RideKind>(rng() % NUM_RIDE_KINDS);
+        t.id = "R" + std::to_string(i);
+        t.pickup = rng() % fleet.zones.size();
+        t.dropoff = rng() % fleet.zones.size();
+        t.miles = std::round(miles(rng) * 10.0) / 10.0;
+        t.surge = tierSurge(t.kind, std::round(surge(rng) * 100.0) / 100.0, static_cast<int>(rng() % 24));
+        t.driver = rng() % spec.drivers;
+        t.rider = rng() % spec.riders;
+        fleet.trips.push_back(std::move(t));
+    }
+    return fleet;
+}
+
+int main(int argc, char** argv) {
+    FleetSpec spec;
+    bench_session session;
+    bench_session_init(&session, "ride_share");
+    session.cfg.reps = 3;
+    session.cfg.alloc_count = alloc_count;
+    for (int i = 1; i < argc; ++i) {
+        const int common = bench_session_option(&session, argc, argv, &i);
+        if (common > 0) continue;
+        const string flag = argv[i];
+        const bool valued = common == 0 && i + 1 < argc;
+        if (valued && flag == "--rides") spec.rides = strtoull(argv[++i], nullptr, 10);
+        else if (valued && flag == "--drivers") spec.drivers = strtoull(argv[++i], nullptr, 10);
+        else if (valued && flag == "--riders") spec.riders = strtoull(argv[++i], nullptr, 10);
+        else {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (spec.rides == 0 || spec.drivers == 0 || spec.riders == 0) {
+        fprintf(stderr, "--rides, --drivers and --riders must be positive\n");
+        return 1;
+    }
+    spec.seed = static_cast<unsigned>(session.seed);
+
+    try {
+        const SyntheticFleet fleet = synthetic_fleet(spec);
+        const size_t n = fleet.trips.size();
+        if (session.table) printf("rides=%zu drivers=%zu riders=%zu\n", n, spec.drivers, spec.riders);
+        if (!bench_session_start(&session)) return 1;
+        const bench_config& cfg = session.cfg;
+        auto report = [&](const char* phase, const bench_result& r) { bench_record(&session, phase, n, &r); };
+
+        RideStore store;
+        vector<RideIndex> index(n);
+        report("store.add", bench_measure(cfg, n, [&] { store.reset(); store.reserve(n); }, [&] {
+            for (size_t i = 0; i < n; ++i) {
+                const auto& t = fleet.trips[i];
+                index[i] = store.add(t.kind, t.id, fleet.zones[t.pickup], fleet.zones[t.dropoff], t.miles, t.surge);
+            }
+        }));
+
+        vector<std::unique_ptr<Driver>> drivers;
+        vector<std::unique_ptr<Rider>> riders;
+        // Ledgers only grow, so every repetition starts from fresh people.
+        auto fresh_drivers = [&] {
+            drivers.clear();
+            for (size_t d = 0; d < spec.drivers; ++d)
+                drivers.push_back(std::make_unique<Driver>("D" + std::to_string(d), "driver", 4.5, store));
+        };
+        auto fresh_riders = [&] {
+            riders.clear();
+            for (size_t r = 0; r < spec.riders; ++r)
+                riders.push_back(std::make_unique<Rider>("U" + std::to_string(r), "rider", store));
+        };
+        const int64_t t0 = 1700000000;
+        report("driver.addRide", bench_measure(cfg, n, fresh_drivers, [&] {
+            for (size_t i = 0; i < n; ++i) drivers[fleet.trips[i].driver]->addRide(index[i], t0 + static_cast<int64_t>(i));
+        }));
+        report("rider.requestRide", bench_measure(cfg, n, fresh_riders, [&] {
+            for (size_t i = 0; i < n; ++i) riders[fleet.trips[i].rider]->requestRide(index[i]);
+        }));
+
+        vector<shared_ptr<Ride>> objects;
+        objects.reserve(n);
+        for (size_t i = 0; i < n; ++i) objects.push_back(store.materialize(index[i]));
+        report("fare.virtual", bench_measure(cfg, n, [&] {
+            double sum = 0.0;
+            for (const auto& r : objects) sum += r->fare();
+            bench_consume(sum);
+        }));
+        objects.clear();
+        objects.shrink_to_fit();
+
+        vector<AnyRide> values;
+        values.reserve(n);
+        for (size_t i = 0; i < n; ++i) values.push_back(store.value(index[i]));
+        report("fare.variant", bench_measure(cfg, n, [&] { bench_consume(totalFare(values)); }));
+
+        vector<double> fares;
+        fares.reserve(n);
+        report("fare.kernel", bench_measure(cfg, n, [&] {
+            store.computeFares(fares);
+            bench_consume(fares[n / 2]);
+        }));
+
+        report("driver.totalEarnings", bench_measure(cfg, spec.drivers, [&] {
+            double sum = 0.0;
+            for (const auto& d : drivers) sum += d->totalEarnings();
+            bench_consume(sum);
+        }));
+
+        ReportBuffer out(1 << 20);
+        std::FILE* devnull = std::fopen("/dev/null", "w");
+        if (!devnull) throw std::runtime_error(string("Cannot open /dev/null: ") + std::strerror(errno));
+        report("render.driverInfo", bench_measure(cfg, n, [&] {
+            for (const auto& d : drivers) {
+                d->getDriverInfo(out);
+                if (out.size() > (1 << 19)) out.flush(devnull);
+            }
+            out.flush(devnull);
+        }));
+        std::fclose(devnull);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+    }
+    return bench_session_finish(&session);
+}
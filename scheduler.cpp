@@ -1,103 +1,357 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
 #include <exception>
-#include <iomanip>
+#include <functional>
 #include <iostream>
-#include <random>
+#include <limits>
+#include <mutex>
+#include <queue>
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <variant>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "report_format.hpp"
+
 using namespace std;
 
 static const vector<string> DAYS = {"Mon","Tue","Wed","Thu","Fri","Sat","Sun"};
 static const vector<string> SHIFTS = {"morning","afternoon","evening"};
-static const unordered_set<string> SHIFT_SET = {"morning","afternoon","evening"};
-
-
-struct Config {
-    int min_per_shift = 2;
-    int max_per_shift = 4;            
-    int max_days_per_employee = 5;
-    unsigned int random_seed = 42;
-};
 
-using Schedule = unordered_map<string, unordered_map<string, vector<string>>>;
-using Preferences = unordered_map<string, unordered_map<string, vector<string>>>;
 
+enum class SolverMode { Greedy, Optimal };
 
-using PrefValue = variant<string, vector<string>>;
-using RawPreferences = unordered_map<string, unordered_map<string, PrefValue>>;
-
-
-
-static inline string ltrim(const string& s) {
+static inline string_view ltrim(string_view s) {
     size_t i = 0;
     while (i < s.size() && isspace(static_cast<unsigned char>(s[i]))) ++i;
     return s.substr(i);
 }
 
-static inline string rtrim(const string& s) {
-    if (s.empty()) return s;
+static inline string_view rtrim(string_view s) {
     size_t i = s.size();
     while (i > 0 && isspace(static_cast<unsigned char>(s[i-1]))) --i;
     return s.substr(0, i);
 }
 
-static inline string trim(const string& s) {
+static inline string_view trim(string_view s) {
     return rtrim(ltrim(s));
 }
 
-static inline string to_lower(string s) {
-    transform(s.begin(), s.end(), s.begin(),
-              [](unsigned char c){ return static_cast<char>(tolower(c)); });
-    return s;
+// ASCII case-insensitive equality, so tokens can be validated without lowering a copy.
+static inline bool iequals(string_view a, string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) return false;
+    }
+    return true;
 }
 
+// The planning horizon: day labels and the shift set. Engine state is addressed by
+// dense slot index, slot = day * num_shifts() + shift, so a 4-week, 6-shift horizon
+// is 168 slots and nothing below is sized by a fixed week.
+struct Calendar {
+    vector<string> days = DAYS;
+    vector<string> shifts = SHIFTS;
+
+    size_t num_days() const { return days.size(); }
+    size_t num_shifts() const { return shifts.size(); }
+    size_t slots() const { return days.size() * shifts.size(); }
+    size_t slot(size_t day, size_t shift) const { return day * shifts.size() + shift; }
+
+    int day_index(string_view d) const {
+        for (size_t i = 0; i < days.size(); ++i) {
+            if (days[i] == d) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    // Index of a trimmed, case-insensitive shift name, or -1 if it is not in `shifts`.
+    int shift_index(string_view s) const {
+        s = trim(s);
+        for (size_t i = 0; i < shifts.size(); ++i) {
+            if (iequals(shifts[i], s)) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    // Days [first, first + count) with the same shifts; labels are kept, so warnings
+    // from a window name the horizon's days.
+    Calendar window(size_t first, size_t count) const {
+        Calendar w;
+        w.days.assign(days.begin() + first, days.begin() + first + count);
+        w.shifts = shifts;
+        return w;
+    }
+
+    // `weeks` consecutive weeks labelled Mon..Sun, Mon2..Sun2, Mon3..Sun3, ...
+    static Calendar weekly(size_t weeks, vector<string> shifts = SHIFTS) {
+        Calendar c;
+        c.days.clear();
+        for (size_t w = 0; w < weeks; ++w) {
+            for (const auto& d : DAYS) c.days.push_back(w == 0 ? d : d + to_string(w + 1));
+        }
+        c.shifts = move(shifts);
+        return c;
+    }
+
+    void validate() const {
+        if (days.empty() || shifts.empty()) {
+            throw invalid_argument("Calendar needs at least one day and one shift.");
+        }
+        if (shifts.size() > numeric_limits<uint8_t>::max()) {
+            throw invalid_argument("Calendar supports at most 255 shifts per day.");
+        }
+        for (size_t i = 0; i < days.size(); ++i) {
+            if (day_index(days[i]) != static_cast<int>(i)) throw invalid_argument("Duplicate day label: " + days[i]);
+        }
+        for (size_t i = 0; i < shifts.size(); ++i) {
+            if (shift_index(shifts[i]) != static_cast<int>(i)) throw invalid_argument("Duplicate shift: " + shifts[i]);
+        }
+    }
+};
+
+// Shared by the string- and id-based entry points when no calendar is given.
+static const Calendar& default_calendar() {
+    static const Calendar week;
+    return week;
+}
+
+struct Config {
+    int min_per_shift = 2;
+    int max_per_shift = 4;            
+    int max_days_per_employee = 5;
+    unsigned int random_seed = 42;
+    SolverMode solver = SolverMode::Greedy;
+    int optimal_budget_ms = 2000;     // Optimal falls back to the greedy schedule past this
+    Calendar calendar;                // days and shifts; max_days_per_employee applies per calendar (window)
+};
+
+using Schedule = unordered_map<string, unordered_map<string, vector<string>>>;
+using Preferences = unordered_map<string, unordered_map<string, vector<string>>>;
+
+
+using PrefValue = variant<string, vector<string>>;
+using RawPreferences = unordered_map<string, unordered_map<string, PrefValue>>;
+
+
+
 static vector<string> unique_cleaned(const vector<string>& names) {
     vector<string> out;
-    unordered_set<string> seen;
+    unordered_set<string_view> seen;
     out.reserve(names.size());
-    for (auto n : names) {
-        n = trim(n);
+    for (const auto& raw : names) {
+        string_view n = trim(raw);
         if (n.empty()) continue;
-        if (seen.insert(n).second) out.push_back(n);
+        if (seen.insert(n).second) out.emplace_back(n);
     }
     return out;
 }
 
 
 
-Preferences normalize_preferences(const RawPreferences& raw_prefs) {
+static constexpr size_t MAX_RANK = 3;
+
+using EmpId = uint32_t;
+using RankedShifts = vector<uint8_t>;
+using IdPreferences = vector<vector<RankedShifts>>;     // [employee][calendar day]
+
+// Rosters by dense slot index (see Calendar), each in assignment order.
+struct IdSchedule {
+    size_t shifts = 0;
+    vector<vector<EmpId>> slots;
+
+    IdSchedule() = default;
+    explicit IdSchedule(const Calendar& cal) : shifts(cal.num_shifts()), slots(cal.slots()) {}
+
+    vector<EmpId>& at(size_t day, size_t shift) { return slots[day * shifts + shift]; }
+    const vector<EmpId>& at(size_t day, size_t shift) const { return slots[day * shifts + shift]; }
+};
+
+// Employee names are interned once; the engine below only sees dense ids.
+struct EmployeeTable {
+    vector<string> names;
+    unordered_map<string, EmpId> ids;
+
+    EmpId intern(const string& name) {
+        auto [it, inserted] = ids.emplace(name, static_cast<EmpId>(names.size()));
+        if (inserted) names.push_back(name);
+        return it->second;
+    }
+
+    size_t size() const { return names.size(); }
+};
+
+// Costs are in the units of schedule_cost(); optimal_cost is -1 unless the exact solver finished.
+struct SolverReport {
+    SolverMode used = SolverMode::Greedy;
+    bool timed_out = false;
+    long long greedy_cost = 0;
+    long long optimal_cost = -1;
+    chrono::microseconds optimal_time{0};
+
+    long long gap() const { return optimal_cost < 0 ? 0 : greedy_cost - optimal_cost; }
+};
+
+// Build with -DSCHEDULER_INSTRUMENT=1 to collect ScheduleStats; otherwise the
+// timers and counters below compile to nothing and the stats stay zero.
+#ifndef SCHEDULER_INSTRUMENT
+#define SCHEDULER_INSTRUMENT 0
+#endif
+
+struct ScopedTimer {
+    explicit ScopedTimer(uint64_t& sink_ns) : sink_ns(sink_ns), start(chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        sink_ns = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now() - start).count());
+    }
+
+    uint64_t& sink_ns;
+    chrono::steady_clock::time_point start;
+};
+
+#if SCHEDULER_INSTRUMENT
+#define SCHED_TIMER(sink) ScopedTimer sched_timer_(sink)
+#define SCHED_COUNT(counter) (++(counter))
+#define SCHED_ADD(counter, n) ((counter) += (n))
+#else
+#define SCHED_TIMER(sink) ((void)0)
+#define SCHED_COUNT(counter) ((void)0)
+#define SCHED_ADD(counter, n) ((void)0)
+#endif
+
+// Preference-phase counters are kept per day so a partial replay stays exact.
+struct PreferenceCounters {
+    array<uint64_t, MAX_RANK> placed_by_rank{};
+    uint64_t fallback_placed = 0;
+    uint64_t carried_over = 0;
+};
+
+// One max-cap rebalance transfer, in calendar slot indices; `to` is NO_SLOT when
+// the employee was dropped.
+struct RebalanceMove {
+    static constexpr uint32_t NO_SLOT = numeric_limits<uint32_t>::max();
+
+    EmpId emp;
+    uint32_t from, to;
+};
+
+struct ScheduleStats {
+    bool enabled = SCHEDULER_INSTRUMENT;
+    uint64_t preference_ns = 0;         // last replay, which may cover only part of the week
+    uint64_t fill_ns = 0;
+    uint64_t rebalance_ns = 0;
+    PreferenceCounters preference;
+    uint64_t random_fills = 0;
+    uint64_t understaffed_slots = 0;
+    uint64_t relocated_same_day = 0;
+    uint64_t relocated_next_day = 0;
+    uint64_t relocated_augmented = 0;   // placed by first moving someone out of a full slot
+    uint64_t dropped = 0;
+    uint64_t surplus_seats = 0;         // over max_per_shift when the rebalance started
+    vector<RebalanceMove> moves;        // every relocation and drop, in order
+
+    string to_json() const {
+        string moves_json;
+        for (const auto& m : moves) {
+            if (!moves_json.empty()) moves_json += ",";
+            moves_json += "[" + to_string(m.emp) + "," + to_string(m.from) + "," +
+                          (m.to == RebalanceMove::NO_SLOT ? string("null") : to_string(m.to)) + "]";
+        }
+        const auto& r = preference.placed_by_rank;
+        return string("{\"enabled\":") + (enabled ? "true" : "false") +
+               ",\"preference_ns\":" + to_string(preference_ns) +
+               ",\"fill_ns\":" + to_string(fill_ns) +
+               ",\"rebalance_ns\":" + to_string(rebalance_ns) +
+               ",\"placed_by_rank\":[" + to_string(r[0]) + "," + to_string(r[1]) + "," + to_string(r[2]) + "]" +
+               ",\"fallback_placed\":" + to_string(preference.fallback_placed) +
+               ",\"carried_over\":" + to_string(preference.carried_over) +
+               ",\"random_fills\":" + to_string(random_fills) +
+               ",\"understaffed_slots\":" + to_string(understaffed_slots) +
+               ",\"relocated_same_day\":" + to_string(relocated_same_day) +
+               ",\"relocated_next_day\":" + to_string(relocated_next_day) +
+               ",\"relocated_augmented\":" + to_string(relocated_augmented) +
+               ",\"dropped\":" + to_string(dropped) +
+               ",\"surplus_seats\":" + to_string(surplus_seats) +
+               ",\"moves\":[" + moves_json + "]}";
+    }
+
+    // Folds in another window's stats; a rolling schedule reports the whole horizon.
+    // `slot_offset` is the window's first slot in the horizon.
+    void add(const ScheduleStats& o, size_t slot_offset = 0) {
+        preference_ns += o.preference_ns;
+        fill_ns += o.fill_ns;
+        rebalance_ns += o.rebalance_ns;
+        for (size_t r = 0; r < MAX_RANK; ++r) preference.placed_by_rank[r] += o.preference.placed_by_rank[r];
+        preference.fallback_placed += o.preference.fallback_placed;
+        preference.carried_over += o.preference.carried_over;
+        random_fills += o.random_fills;
+        understaffed_slots += o.understaffed_slots;
+        relocated_same_day += o.relocated_same_day;
+        relocated_next_day += o.relocated_next_day;
+        relocated_augmented += o.relocated_augmented;
+        dropped += o.dropped;
+        surplus_seats += o.surplus_seats;
+        const auto shift = static_cast<uint32_t>(slot_offset);
+        for (auto m : o.moves) {
+            m.from += shift;
+            if (m.to != RebalanceMove::NO_SLOT) m.to += shift;
+            moves.push_back(m);
+        }
+    }
+};
+
+struct IdResult {
+    IdSchedule sched;
+    vector<int> days_worked;
+    vector<string> warnings;
+    ScheduleStats stats;
+    SolverReport report;
+};
+
+static RankedShifts normalize_ranked(const PrefValue& val, const Calendar& cal) {
+    RankedShifts ranked;
+    auto add = [&](const string& raw) {
+        int si = cal.shift_index(raw);
+        if (si >= 0) ranked.push_back(static_cast<uint8_t>(si));
+    };
+    if (holds_alternative<string>(val)) {
+        add(get<string>(val));
+    } else {
+        for (const auto& s : get<vector<string>>(val)) add(s);
+    }
+    return ranked;
+}
+
+Preferences normalize_preferences(const RawPreferences& raw_prefs, const Calendar& cal = default_calendar()) {
     Preferences prefs;
 
     for (const auto& [emp, per_day] : raw_prefs) {
         auto& emp_map = prefs[emp];
-        for (const auto& day : DAYS) {
+        for (const auto& day : cal.days) {
             vector<string> ranked;
 
             auto it = per_day.find(day);
             if (it != per_day.end()) {
-                const auto& val = it->second;
-                if (holds_alternative<string>(val)) {
-                    string s = to_lower(trim(get<string>(val)));
-                    if (!s.empty() && SHIFT_SET.count(s)) {
-                        ranked.push_back(s);
-                    }
-                } else if (holds_alternative<vector<string>>(val)) {
-                    const auto& vec = get<vector<string>>(val);
-                    for (auto s : vec) {
-                        s = to_lower(trim(s));
-                        if (!s.empty() && SHIFT_SET.count(s)) {
-                            ranked.push_back(s);
-                        }
-                    }
-                }
+                for (uint8_t si : normalize_ranked(it->second, cal)) ranked.push_back(cal.shifts[si]);
             }
             
             emp_map[day] = ranked;
@@ -107,18 +361,138 @@ Preferences normalize_preferences(const RawPreferences& raw_prefs) {
     return prefs;
 }
 
-Schedule empty_schedule() {
+IdPreferences normalize_preferences_ids(const RawPreferences& raw_prefs, const EmployeeTable& table,
+                                        const Calendar& cal = default_calendar()) {
+    IdPreferences prefs(table.size(), vector<RankedShifts>(cal.num_days()));
+    for (EmpId e = 0; e < table.size(); ++e) {
+        auto it = raw_prefs.find(table.names[e]);
+        if (it == raw_prefs.end()) continue;
+        for (size_t d = 0; d < cal.num_days(); ++d) {
+            auto jt = it->second.find(cal.days[d]);
+            if (jt != it->second.end()) prefs[e][d] = normalize_ranked(jt->second, cal);
+        }
+    }
+    return prefs;
+}
+
+struct Roster {
+    EmployeeTable table;
+    IdPreferences prefs;
+};
+
+// Read-only mapping of a whole file; the descriptor is closed once mapped.
+class MappedFile {
+public:
+    explicit MappedFile(const string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw runtime_error("Cannot open " + path + ": " + strerror(errno));
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            int err = errno;
+            ::close(fd);
+            throw runtime_error("Cannot stat " + path + ": " + strerror(err));
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                int err = errno;
+                ::close(fd);
+                throw runtime_error("Cannot map " + path + ": " + strerror(err));
+            }
+            ::madvise(p, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(p);
+        }
+        ::close(fd);
+    }
+
+    ~MappedFile() {
+        if (data_) ::munmap(const_cast<char*>(data_), size_);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    string_view view() const { return {data_, size_}; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// One record per line: `employee,day,shift[;shift...]` (shifts may also be split by '|').
+// Blank lines, '#' comments and an `employee,...` header are skipped, and a line with only
+// a name registers an employee with no preferences. Fields are not quoted. Tokens are
+// trimmed and validated like normalize_preferences(), but straight off the buffer; the
+// only strings allocated are one per distinct employee. A repeated (employee, day)
+// replaces the earlier ranking.
+Roster parse_preferences_csv(string_view text, const string& source = "<input>",
+                             const Calendar& cal = default_calendar()) {
+    Roster roster;
+    unordered_map<string_view, EmpId> seen;     // keys point into `text`
+    bool first_record = true;
+
+    for (size_t line_no = 1; !text.empty(); ++line_no) {
+        const size_t nl = text.find('\n');
+        string_view line = trim(text.substr(0, nl));
+        text = (nl == string_view::npos) ? string_view{} : text.substr(nl + 1);
+        if (line.empty() || line[0] == '#') continue;
+
+        const size_t c1 = line.find(',');
+        string_view name = trim(line.substr(0, c1));
+        string_view rest = (c1 == string_view::npos) ? string_view{} : line.substr(c1 + 1);
+        if (first_record) {
+            first_record = false;
+            if (iequals(name, "employee")) continue;
+        }
+        if (name.empty()) continue;
+
+        auto [it, inserted] = seen.emplace(name, 0);
+        if (inserted) {
+            it->second = roster.table.intern(string(name));
+            roster.prefs.emplace_back(cal.num_days());
+        }
+        if (c1 == string_view::npos) continue;
+
+        const size_t c2 = rest.find(',');
+        string_view day = trim(rest.substr(0, c2));
+        string_view shifts = (c2 == string_view::npos) ? string_view{} : rest.substr(c2 + 1);
+        const int d = cal.day_index(day);
+        if (d < 0) {
+            throw runtime_error(source + ":" + to_string(line_no) + ": unknown day '" + string(day) + "'");
+        }
+
+        RankedShifts& ranked = roster.prefs[it->second][d];
+        ranked.clear();
+        while (!shifts.empty()) {
+            const size_t sep = shifts.find_first_of(";|");
+            int si = cal.shift_index(shifts.substr(0, sep));
+            if (si >= 0) ranked.push_back(static_cast<uint8_t>(si));
+            shifts = (sep == string_view::npos) ? string_view{} : shifts.substr(sep + 1);
+        }
+    }
+    return roster;
+}
+
+Roster load_preferences_csv(const string& path, const Calendar& cal = default_calendar()) {
+    MappedFile file(path);
+    return parse_preferences_csv(file.view(), path, cal);
+}
+
+Schedule empty_schedule(const Calendar& cal = default_calendar()) {
     Schedule sched;
-    for (const auto& day : DAYS) {
+    for (const auto& day : cal.days) {
         auto& per_shift = sched[day];
-        for (const auto& s : SHIFTS) per_shift[s] = {};
+        for (const auto& s : cal.shifts) per_shift[s] = {};
     }
     return sched;
 }
 
-void feasible_or_raise(const vector<string>& employees, const Config& cfg) {
-    int required = static_cast<int>(DAYS.size() * SHIFTS.size() * cfg.min_per_shift);
-    int supply = static_cast<int>(employees.size() * cfg.max_days_per_employee);
+void feasible_or_raise(size_t employee_count, const Config& cfg) {
+    int required = static_cast<int>(cfg.calendar.slots() * cfg.min_per_shift);
+    int supply = static_cast<int>(employee_count * cfg.max_days_per_employee);
     if (supply < required) {
         int deficit = required - supply;
         int need_more = deficit / cfg.max_days_per_employee + ((deficit % cfg.max_days_per_employee) ? 1 : 0);
@@ -130,224 +504,1227 @@ void feasible_or_raise(const vector<string>& employees, const Config& cfg) {
     }
 }
 
-pair<Schedule, vector<string>> schedule_employees(
-    vector<string> employees,
-    const RawPreferences& raw_preferences,
-    Config cfg = Config()
-) {
-    
-    mt19937 rng(cfg.random_seed);
+void feasible_or_raise(const vector<string>& employees, const Config& cfg) {
+    feasible_or_raise(employees.size(), cfg);
+}
 
-    
-    employees = unique_cleaned(employees);
-    if (employees.empty()) {
+EmployeeTable intern_employees(const vector<string>& employees) {
+    EmployeeTable table;
+    for (const auto& e : unique_cleaned(employees)) table.intern(e);
+    if (table.size() == 0) {
         throw invalid_argument("No employees provided.");
     }
+    return table;
+}
+
+// Dense per-employee bitset; word-wide loops over `words` are what the
+// greedy passes scan instead of probing per-employee state.
+struct DenseBitset {
+    vector<uint64_t> words;
+
+    void resize(size_t bits) { words.assign((bits + 63) / 64, 0); }
+    bool test(size_t i) const { return (words[i >> 6] >> (i & 63)) & 1u; }
+    void set(size_t i) { words[i >> 6] |= uint64_t{1} << (i & 63); }
+    void reset(size_t i) { words[i >> 6] &= ~(uint64_t{1} << (i & 63)); }
+    const uint64_t* data() const { return words.data(); }
+};
+
+// Rows of per-employee bits in one flat allocation (days x employees,
+// (slot, rank) x employees); each row has a DenseBitset's word layout.
+struct BitMatrix {
+    size_t row_words = 0;
+    vector<uint64_t> words;
+
+    void resize(size_t rows, size_t bits) {
+        row_words = (bits + 63) / 64;
+        words.assign(rows * row_words, 0);
+    }
+    uint64_t* row(size_t r) { return words.data() + r * row_words; }
+    const uint64_t* row(size_t r) const { return words.data() + r * row_words; }
+    bool test(size_t r, size_t i) const { return (row(r)[i >> 6] >> (i & 63)) & 1u; }
+    void set(size_t r, size_t i) { row(r)[i >> 6] |= uint64_t{1} << (i & 63); }
+    void reset(size_t r, size_t i) { row(r)[i >> 6] &= ~(uint64_t{1} << (i & 63)); }
+    void clear_row(size_t r) { fill_n(row(r), row_words, uint64_t{0}); }
+};
+
+// out = keep & ~(a | b | c) over `w` words. Branch-free so the compiler emits SIMD for it.
+static void mask_andn(vector<uint64_t>& out, size_t w, const uint64_t* k, const uint64_t* a,
+                      const uint64_t* b, const uint64_t* c) {
+    out.resize(w);
+    uint64_t* o = out.data();
+    for (size_t i = 0; i < w; ++i) o[i] = k[i] & ~(a[i] | b[i] | c[i]);
+}
+
+// Calls f(id) for each set bit in ascending order; stops early once f returns false.
+template <typename F>
+static void for_each_bit(const vector<uint64_t>& mask, F&& f) {
+    for (size_t wi = 0; wi < mask.size(); ++wi) {
+        uint64_t word = mask[wi];
+        while (word) {
+            const EmpId id = static_cast<EmpId>(wi * 64 + static_cast<size_t>(__builtin_ctzll(word)));
+            if (!f(id)) return;
+            word &= word - 1;
+        }
+    }
+}
 
-    feasible_or_raise(employees, cfg);
+// Shared objective for the greedy and optimal solvers, lower is better: an employee's
+// r-th distinct preferred shift costs r, any other shift costs COST_UNPREFERRED, a day
+// with preferences but no assignment costs COST_MISSED, and each seat below
+// min_per_shift costs COST_SHORTFALL.
+static constexpr long long COST_UNPREFERRED = 4;
+static constexpr long long COST_MISSED = 6;
+static constexpr long long COST_SHORTFALL = 100;
+
+// Position of `shift` among the distinct entries of `ranked`, or -1. Rankings hold
+// at most a few shifts, so a scan beats building a per-shift table.
+static int preference_rank(const RankedShifts& ranked, size_t shift) {
+    int next = 0;
+    for (size_t i = 0; i < ranked.size(); ++i) {
+        if (find(ranked.begin(), ranked.begin() + i, ranked[i]) != ranked.begin() + i) continue;
+        if (ranked[i] == shift) return next;
+        ++next;
+    }
+    return -1;
+}
 
-    Preferences prefs = normalize_preferences(raw_preferences);
-    Schedule sched = empty_schedule();
+long long schedule_cost(const IdSchedule& sched, const IdPreferences& prefs, const DenseBitset& active,
+                        const Config& cfg) {
+    const Calendar& cal = cfg.calendar;
+    long long cost = 0;
+    vector<uint8_t> worked(prefs.size());
+    for (size_t d = 0; d < cal.num_days(); ++d) {
+        fill(worked.begin(), worked.end(), 0);
+        for (size_t s = 0; s < cal.num_shifts(); ++s) {
+            for (EmpId e : sched.at(d, s)) {
+                int r = preference_rank(prefs[e][d], s);
+                cost += r >= 0 ? r : COST_UNPREFERRED;
+                worked[e] = 1;
+            }
+            cost += COST_SHORTFALL * max<long long>(0, cfg.min_per_shift - static_cast<long long>(sched.at(d, s).size()));
+        }
+        for (EmpId e = 0; e < prefs.size(); ++e) {
+            if (active.test(e) && !worked[e] && !prefs[e][d].empty()) cost += COST_MISSED;
+        }
+    }
+    return cost;
+}
 
-    unordered_map<string, unordered_set<string>> assigned_on_day;
-    for (const auto& d : DAYS) assigned_on_day[d] = {};
+// Successive-shortest-path min-cost flow with Johnson potentials. Stops once no
+// augmenting path lowers the cost, which is the minimum over all flow values.
+class MinCostFlow {
+public:
+    struct EdgeRef { uint32_t from, index; };
 
-    unordered_map<string, int> days_worked;
-    for (const auto& e : employees) days_worked[e] = 0;
+    explicit MinCostFlow(size_t nodes) : graph_(nodes) {}
 
-    vector<string> warnings;
+    EdgeRef add_edge(size_t from, size_t to, int cap, long long cost) {
+        EdgeRef ref{static_cast<uint32_t>(from), static_cast<uint32_t>(graph_[from].size())};
+        graph_[from].push_back({static_cast<uint32_t>(to), static_cast<uint32_t>(graph_[to].size()), cap, cost});
+        graph_[to].push_back({static_cast<uint32_t>(from), ref.index, 0, -cost});
+        return ref;
+    }
+
+    int flow(EdgeRef ref) const {
+        const Edge& e = graph_[ref.from][ref.index];
+        return graph_[e.to][e.rev].cap;
+    }
+
+    // Edges must run from lower to higher node index (the initial potentials are a
+    // single topological relaxation). Returns false if `deadline` passed first.
+    bool run(size_t s, size_t t, chrono::steady_clock::time_point deadline) {
+        const size_t n = graph_.size();
+        vector<long long> pot(n, INF);
+        pot[s] = 0;
+        for (size_t v = 0; v < n; ++v) {
+            if (pot[v] == INF) continue;
+            for (const Edge& e : graph_[v]) {
+                if (e.cap > 0 && pot[v] + e.cost < pot[e.to]) pot[e.to] = pot[v] + e.cost;
+            }
+        }
+        for (auto& p : pot) {
+            if (p == INF) p = 0;
+        }
+
+        vector<long long> dist(n);
+        vector<pair<uint32_t, uint32_t>> parent(n);
+        using Item = pair<long long, uint32_t>;
+        priority_queue<Item, vector<Item>, greater<Item>> pq;
+
+        for (;;) {
+            if (chrono::steady_clock::now() > deadline) return false;
+
+            fill(dist.begin(), dist.end(), INF);
+            dist[s] = 0;
+            pq.push({0, static_cast<uint32_t>(s)});
+            while (!pq.empty()) {
+                auto [d, v] = pq.top();
+                pq.pop();
+                if (d > dist[v]) continue;
+                for (uint32_t i = 0; i < graph_[v].size(); ++i) {
+                    const Edge& e = graph_[v][i];
+                    if (e.cap <= 0) continue;
+                    long long nd = d + e.cost + pot[v] - pot[e.to];
+                    if (nd < dist[e.to]) {
+                        dist[e.to] = nd;
+                        parent[e.to] = {v, i};
+                        pq.push({nd, e.to});
+                    }
+                }
+            }
+            if (dist[t] == INF) return true;
+            for (size_t v = 0; v < n; ++v) {
+                if (dist[v] != INF) pot[v] += dist[v];
+            }
+            if (pot[t] - pot[s] >= 0) return true;
+
+            int push = numeric_limits<int>::max();
+            for (size_t v = t; v != s; v = parent[v].first) {
+                push = min(push, graph_[parent[v].first][parent[v].second].cap);
+            }
+            for (size_t v = t; v != s; v = parent[v].first) {
+                Edge& e = graph_[parent[v].first][parent[v].second];
+                e.cap -= push;
+                graph_[v][e.rev].cap += push;
+                cost_ += static_cast<long long>(push) * e.cost;
+            }
+        }
+    }
+
+    long long cost() const { return cost_; }
+
+private:
+    static constexpr long long INF = numeric_limits<long long>::max() / 4;
+
+    struct Edge {
+        uint32_t to, rev;
+        int cap;
+        long long cost;
+    };
+
+    vector<vector<Edge>> graph_;
+    long long cost_ = 0;
+};
+
+static string understaffed_warning(const Calendar& cal, size_t day, size_t shift, size_t have, int min_per_shift) {
+    return "Warning: Could not meet min staffing for " + cal.days[day] + " " + cal.shifts[shift] +
+           " (" + to_string(have) + "/" + to_string(min_per_shift) +
+           "). Consider more staff or relaxing caps.";
+}
+
+// Assignment state shared by the passes: the per-slot rosters, a days x employees
+// "already assigned" matrix and the days-worked counters behind `exhausted`. An
+// employee holds at most one slot per day, so the day row plus the rosters is the
+// whole slots x employees assignment without storing a row per slot.
+struct WeekState {
+    IdSchedule sched;
+    BitMatrix assigned_on_day;
+    vector<int> days_worked;
+    DenseBitset exhausted;
+
+    void assign(size_t day, size_t shift, EmpId emp, int max_days) {
+        sched.at(day, shift).push_back(emp);
+        assigned_on_day.set(day, emp);
+        if (++days_worked[emp] >= max_days) exhausted.set(emp);
+    }
+
+    void unassign(size_t day, EmpId emp, int max_days) {
+        assigned_on_day.reset(day, emp);
+        if (--days_worked[emp] < max_days) exhausted.reset(emp);
+    }
+
+    bool available(size_t day, EmpId emp) const {
+        return !assigned_on_day.test(day, emp) && !exhausted.test(emp);
+    }
+
+    void sync_exhausted(int max_days) {
+        for (size_t w = 0; w < exhausted.words.size(); ++w) exhausted.words[w] = 0;
+        for (EmpId e = 0; e < days_worked.size(); ++e) {
+            if (days_worked[e] >= max_days) exhausted.set(e);
+        }
+    }
+};
+
+// splitmix64 step: the min-staffing fill draws from this instead of shuffling
+// a candidate list per slot, so picks stay reproducible under random_seed.
+static inline uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// Fill candidates bucketed by remaining capacity (max_days - days_worked),
+// clamped to the calendar length: nobody can use more days than it has, so a
+// larger cap behaves the same and only the buckets that can differ are kept.
+// Draws take a seeded-random member of the fullest bucket; everyone drawn on a
+// day is parked and returned by end_day() under their new capacity, so a day's
+// draws cost O(assignments + employees already placed that day) and the pool is
+// built once per fill.
+struct FillPool {
+    vector<vector<EmpId>> by_remaining;     // [remaining capacity]; bucket 0 stays empty
+    vector<pair<EmpId, int>> parked;
+    size_t top = 0;
+    uint64_t state = 0;
+
+    void reset(int max_days, size_t days, uint64_t seed) {
+        by_remaining.resize(min(static_cast<size_t>(max(max_days, 0)), days) + 1);
+        for (auto& bucket : by_remaining) bucket.clear();
+        parked.clear();
+        top = 0;
+        state = seed;
+    }
+
+    void add(EmpId emp, int remaining) {
+        if (remaining <= 0) return;
+        const size_t bucket = min(static_cast<size_t>(remaining), by_remaining.size() - 1);
+        by_remaining[bucket].push_back(emp);
+        top = max(top, bucket);
+    }
+
+    bool draw(EmpId& emp, int& remaining) {
+        while (top > 0 && by_remaining[top].empty()) --top;
+        if (top == 0) return false;
+        auto& bucket = by_remaining[top];
+        const size_t i = static_cast<size_t>(((splitmix64(state) >> 32) * bucket.size()) >> 32);
+        emp = bucket[i];
+        remaining = static_cast<int>(top);
+        bucket[i] = bucket.back();
+        bucket.pop_back();
+        return true;
+    }
+
+    void park(EmpId emp, int remaining) { parked.push_back({emp, remaining}); }
+
+    void end_day() {
+        for (auto [emp, remaining] : parked) add(emp, remaining);
+        parked.clear();
+    }
+};
 
-    auto shift_has_capacity = [&](const string& day, const string& shift) -> bool {
-        if (cfg.max_per_shift <= 0) return true;
-        return static_cast<int>(sched[day][shift].size()) < cfg.max_per_shift;
+// Stateful solver over one calendar. The preference phase is checkpointed per
+// day, so an edit on day d replays only from d and stops as soon as the
+// carry-over list and days-worked counters match the stored checkpoint again.
+// The lists are kept one past the last day: employees still unplaced after it
+// are the carry-out, which RollingScheduler feeds into the next window as its
+// carry-in. The min-staffing and max-cap passes depend on the whole calendar
+// and on the seeded RNG stream, so they are re-derived from the stored
+// preference-phase state; the result is always the same as a fresh solve with
+// the edited inputs.
+class SchedulerBench;
+
+class Scheduler {
+    friend class SchedulerBench;     // scheduler_bench.cpp times the private phases
+
+public:
+    Scheduler(EmployeeTable table, IdPreferences prefs, const Config& cfg, vector<EmpId> carry_in = {})
+        : table_(move(table)), prefs_(move(prefs)), cfg_(cfg) {
+        const size_t n = table_.size();
+        if (n == 0) {
+            throw invalid_argument("No employees provided.");
+        }
+        cfg_.calendar.validate();
+        feasible_or_raise(n, cfg_);
+        build_slot_adjacency();
+        prefs_.resize(n);
+        for (auto& per_day : prefs_) {
+            if (per_day.empty()) per_day.resize(cfg_.calendar.num_days());
+            if (per_day.size() != cfg_.calendar.num_days()) {
+                throw invalid_argument("Preferences cover " + to_string(per_day.size()) + " days; the calendar has " +
+                                       to_string(cfg_.calendar.num_days()) + ".");
+            }
+        }
+        active_count_ = n;
+
+        const size_t days = cfg_.calendar.num_days();
+        active_.resize(n);
+        carried_.resize(n);
+        for (EmpId e = 0; e < n; ++e) active_.set(e);
+
+        pref_.sched = IdSchedule(cfg_.calendar);
+        pref_.days_worked.assign(n, 0);
+        pref_.exhausted.resize(n);
+        pref_.assigned_on_day.resize(days, n);
+        wants_day_.resize(days, n);
+        prefers_.resize(cfg_.calendar.slots() * MAX_RANK, n);
+        for (EmpId e = 0; e < n; ++e) {
+            for (size_t d = 0; d < days; ++d) set_pref_bits(e, d, true);
+        }
+        carry_over_next_day_.assign(days + 1, {});
+        carry_over_next_day_[0] = move(carry_in);
+        day_start_worked_.assign(days + 1, {});
+        day_start_worked_[0].assign(n, 0);
+        day_counters_.assign(days, PreferenceCounters());
+
+        replay_from(0, days);
+        finish();
+    }
+
+    Scheduler(const vector<string>& employees, const RawPreferences& raw_preferences, const Config& cfg = Config())
+        : Scheduler(intern_from(employees, raw_preferences, cfg)) {}
+
+    void update_preference(const string& emp, const string& day, const PrefValue& ranked) {
+        const EmpId id = lookup(emp);
+        const int d = cfg_.calendar.day_index(day);
+        if (d < 0) {
+            throw invalid_argument("Unknown day: " + day);
+        }
+        set_pref_bits(id, d, false);
+        prefs_[id][d] = normalize_ranked(ranked, cfg_.calendar);
+        set_pref_bits(id, d, true);
+
+        replay_from(static_cast<size_t>(d), static_cast<size_t>(d));
+        finish();
+    }
+
+    void remove_employee(const string& emp) {
+        const EmpId id = lookup(emp);
+        feasible_or_raise(active_count_ - 1, cfg_);
+
+        // Only days where `emp` was placed or carried into can change.
+        const size_t days = cfg_.calendar.num_days();
+        size_t first = days, last = 0;
+        for (size_t d = 0; d < days; ++d) {
+            const auto& carry = carry_over_next_day_[d];
+            if (pref_.assigned_on_day.test(d, id) || find(carry.begin(), carry.end(), id) != carry.end()) {
+                first = min(first, d);
+                last = d;
+            }
+        }
+
+        active_.reset(id);
+        --active_count_;
+        for (size_t d = 0; d < days; ++d) set_pref_bits(id, d, false);
+        for (auto& worked : day_start_worked_) worked[id] = 0;
+
+        if (first < days) replay_from(first, last);
+        finish();
+    }
+
+    // Replaces the employees carried into the first day. Returns false, without
+    // re-solving, when the list is unchanged.
+    bool set_carry_in(vector<EmpId> carry_in) {
+        if (carry_in == carry_over_next_day_[0]) return false;
+        carry_over_next_day_[0] = move(carry_in);
+        replay_from(0, 0);
+        finish();
+        return true;
+    }
+
+    // Employees with preferences on the last day that could not be placed on it.
+    const vector<EmpId>& carry_out() const { return carry_over_next_day_[cfg_.calendar.num_days()]; }
+
+    const IdResult& result() const { return final_; }
+    const EmployeeTable& employees() const { return table_; }
+    const Calendar& calendar() const { return cfg_.calendar; }
+
+private:
+    struct Inputs {
+        EmployeeTable table;
+        IdPreferences prefs;
+        Config cfg;
     };
 
-    
-    unordered_map<string, vector<string>> carry_over_next_day;
-    for (const auto& d : DAYS) carry_over_next_day[d] = {};
+    explicit Scheduler(Inputs in) : Scheduler(move(in.table), move(in.prefs), in.cfg) {}
 
-    for (size_t di = 0; di < DAYS.size(); ++di) {
-        const string& day = DAYS[di];
+    static Inputs intern_from(const vector<string>& employees, const RawPreferences& raw, const Config& cfg) {
+        EmployeeTable table = intern_employees(employees);
+        IdPreferences prefs = normalize_preferences_ids(raw, table, cfg.calendar);
+        return {move(table), move(prefs), cfg};
+    }
+
+    EmpId lookup(const string& emp) const {
+        auto it = table_.ids.find(emp);
+        if (it == table_.ids.end() || !active_.test(it->second)) {
+            throw invalid_argument("Unknown employee: " + emp);
+        }
+        return it->second;
+    }
+
+    size_t prefers_row(size_t day, size_t shift, size_t rank) const { return cfg_.calendar.slot(day, shift) * MAX_RANK + rank; }
 
-       
-        vector<string> order;
-        unordered_set<string> carry_set(carry_over_next_day[day].begin(), carry_over_next_day[day].end());
-        order.insert(order.end(), carry_over_next_day[day].begin(), carry_over_next_day[day].end());
-        for (const auto& e : employees) {
-            if (!carry_set.count(e)) order.push_back(e);
+    void set_pref_bits(EmpId emp, size_t day, bool on) {
+        const auto& ranked = prefs_[emp][day];
+        if (ranked.empty()) return;
+        on ? wants_day_.set(day, emp) : wants_day_.reset(day, emp);
+        for (size_t r = 0; r < ranked.size() && r < MAX_RANK; ++r) {
+            const size_t row = prefers_row(day, ranked[r], r);
+            on ? prefers_.set(row, emp) : prefers_.reset(row, emp);
         }
+    }
 
-       
-        for (int rank = 0; rank < 3; ++rank) {
-            for (const auto& emp : order) {
-                if (assigned_on_day[day].count(emp)) continue;
-                if (days_worked[emp] >= cfg.max_days_per_employee) continue;
+    bool shift_has_capacity(const WeekState& st, size_t day, size_t shift) const {
+        if (cfg_.max_per_shift <= 0) return true;
+        return static_cast<int>(st.sched.at(day, shift).size()) < cfg_.max_per_shift;
+    }
+
+    // Re-runs the preference phase from `first`; once past `settle` (the last day
+    // whose inputs changed) it stops at the first checkpoint that is unchanged.
+    void replay_from(size_t first, size_t settle) {
+        SCHED_TIMER(stats_.preference_ns);
+        const size_t days = cfg_.calendar.num_days();
+        pref_.days_worked = day_start_worked_[first];
+        pref_.sync_exhausted(cfg_.max_days_per_employee);
+
+        vector<EmpId> old_carry;
+        for (size_t day = first; day < days; ++day) {
+            for (size_t s = 0; s < cfg_.calendar.num_shifts(); ++s) pref_.sched.at(day, s).clear();
+            pref_.assigned_on_day.clear_row(day);
+            old_carry.clear();
+            old_carry.swap(carry_over_next_day_[day + 1]);
+
+            run_day(day);
+
+            const bool converged = day >= settle &&
+                                   pref_.days_worked == day_start_worked_[day + 1] &&
+                                   old_carry == carry_over_next_day_[day + 1];
+            if (converged) {
+                pref_.days_worked = day_start_worked_[days];
+                pref_.sync_exhausted(cfg_.max_days_per_employee);
+                return;
+            }
+            day_start_worked_[day + 1] = pref_.days_worked;
+        }
+    }
 
-                const auto& ranked = prefs[emp][day]; 
-                if (rank >= static_cast<int>(ranked.size())) continue;
-                const string& target = ranked[rank];
-                if (!SHIFT_SET.count(target)) continue;
+    void run_day(size_t day) {
+        const int max_days = cfg_.max_days_per_employee;
+        const size_t shifts = cfg_.calendar.num_shifts();
+        const size_t words = active_.words.size();
+        PreferenceCounters& counters = day_counters_[day];
+        counters = PreferenceCounters();
+        (void)counters;
+
+        // Carried-over employees go first, then everyone else in id order.
+        vector<EmpId> carry;
+        for (EmpId e : carry_over_next_day_[day]) {
+            if (active_.test(e)) carry.push_back(e);
+        }
+        for (EmpId e : carry) carried_.set(e);
+
+        // Each employee has one target per rank, so shifts can be scanned independently.
+        for (size_t rank = 0; rank < MAX_RANK; ++rank) {
+            for (size_t shift = 0; shift < shifts; ++shift) {
+                const size_t wanted = prefers_row(day, shift, rank);
+                for (EmpId emp : carry) {
+                    if (!shift_has_capacity(pref_, day, shift)) break;
+                    if (prefers_.test(wanted, emp) && pref_.available(day, emp)) {
+                        pref_.assign(day, shift, emp, max_days);
+                        SCHED_COUNT(counters.placed_by_rank[rank]);
+                    }
+                }
+                if (!shift_has_capacity(pref_, day, shift)) continue;
+                mask_andn(mask_, words, prefers_.row(wanted), pref_.assigned_on_day.row(day), pref_.exhausted.data(),
+                          carried_.data());
+                for_each_bit(mask_, [&](EmpId emp) {
+                    pref_.assign(day, shift, emp, max_days);
+                    SCHED_COUNT(counters.placed_by_rank[rank]);
+                    return shift_has_capacity(pref_, day, shift);
+                });
+            }
+        }
 
-                if (shift_has_capacity(day, target)) {
-                    sched[day][target].push_back(emp);
-                    assigned_on_day[day].insert(emp);
-                    days_worked[emp] += 1;
+        // Ranked shifts first, then the rest in calendar order; the last day's
+        // leftovers become the carry-out.
+        auto fallback = [&](EmpId emp) {
+            const auto& ranked = prefs_[emp][day];
+            for (uint8_t s : ranked) {
+                if (shift_has_capacity(pref_, day, s)) {
+                    pref_.assign(day, s, emp, max_days);
+                    SCHED_COUNT(counters.fallback_placed);
+                    return true;
                 }
             }
+            for (size_t s = 0; s < shifts; ++s) {
+                if (find(ranked.begin(), ranked.end(), s) != ranked.end()) continue;
+                if (shift_has_capacity(pref_, day, s)) {
+                    pref_.assign(day, s, emp, max_days);
+                    SCHED_COUNT(counters.fallback_placed);
+                    return true;
+                }
+            }
+            carry_over_next_day_[day + 1].push_back(emp);
+            if (day + 1 < cfg_.calendar.num_days()) SCHED_COUNT(counters.carried_over);
+            return true;
+        };
+
+        for (EmpId emp : carry) {
+            if (wants_day_.test(day, emp) && pref_.available(day, emp)) fallback(emp);
         }
+        mask_andn(mask_, words, wants_day_.row(day), pref_.assigned_on_day.row(day), pref_.exhausted.data(),
+                  carried_.data());
+        for_each_bit(mask_, fallback);
 
-     
-        for (const auto& emp : order) {
-            if (assigned_on_day[day].count(emp)) continue;
-            if (days_worked[emp] >= cfg.max_days_per_employee) continue;
+        for (EmpId e : carry) carried_.reset(e);
+    }
 
-            const auto& ranked = prefs[emp][day];
-            if (!ranked.empty()) {
-                bool placed = false;
-                unordered_set<string> seen(ranked.begin(), ranked.end());
+    void finish() {
+        WeekState st = pref_;
+        vector<string> warnings;
+        fill_min_staffing(st, warnings);
+        rebalance_max_cap(st, warnings);
+
+#if SCHEDULER_INSTRUMENT
+        stats_.preference = PreferenceCounters();
+        for (const auto& c : day_counters_) {
+            for (size_t r = 0; r < MAX_RANK; ++r) stats_.preference.placed_by_rank[r] += c.placed_by_rank[r];
+            stats_.preference.fallback_placed += c.fallback_placed;
+            stats_.preference.carried_over += c.carried_over;
+        }
+#endif
+
+        final_.sched = move(st.sched);
+        final_.days_worked = move(st.days_worked);
+        final_.warnings = move(warnings);
+        final_.stats = stats_;
+        final_.report = SolverReport();
+        final_.report.greedy_cost = schedule_cost(final_.sched, prefs_, active_, cfg_);
+        if (cfg_.solver == SolverMode::Optimal) solve_optimal();
+    }
 
-                vector<string> try_order = ranked; 
-                for (const auto& s : SHIFTS) {
-                    if (!seen.count(s)) try_order.push_back(s);
+    void fill_min_staffing(WeekState& st, vector<string>& warnings) {
+        SCHED_TIMER(stats_.fill_ns);
+        stats_.random_fills = stats_.understaffed_slots = 0;
+        const int max_days = cfg_.max_days_per_employee;
+        const Calendar& cal = cfg_.calendar;
+        IdSchedule& sched = st.sched;
+
+        bool pooled = false;    // built on the first understaffed slot
+        for (size_t day = 0; day < cal.num_days(); ++day) {
+            for (size_t shift = 0; shift < cal.num_shifts(); ++shift) {
+                auto& roster = sched.at(day, shift);
+                const int have = static_cast<int>(roster.size());
+                int need = cfg_.min_per_shift - have;
+                if (need <= 0) continue;
+                if (cfg_.max_per_shift > 0) need = min(need, cfg_.max_per_shift - have);
+
+                if (!pooled) {
+                    fill_pool_.reset(max_days, cal.num_days(), cfg_.random_seed);
+                    for_each_bit(active_.words, [&](EmpId e) {
+                        fill_pool_.add(e, max_days - st.days_worked[e]);
+                        return true;
+                    });
+                    pooled = true;
                 }
 
-                for (const auto& s : try_order) {
-                    if (shift_has_capacity(day, s)) {
-                        sched[day][s].push_back(emp);
-                        assigned_on_day[day].insert(emp);
-                        days_worked[emp] += 1;
-                        placed = true;
-                        break;
+                EmpId emp;
+                int remaining;
+                for (int added = 0; added < need && fill_pool_.draw(emp, remaining);) {
+                    if (st.assigned_on_day.test(day, emp)) {
+                        fill_pool_.park(emp, remaining);
+                        continue;
                     }
+                    st.assign(day, shift, emp, max_days);
+                    fill_pool_.park(emp, remaining - 1);
+                    SCHED_COUNT(stats_.random_fills);
+                    added += 1;
                 }
-                if (!placed) {
-                    if (di + 1 < DAYS.size()) {
-                        carry_over_next_day[DAYS[di + 1]].push_back(emp);
-                    }
+
+                if (static_cast<int>(roster.size()) < cfg_.min_per_shift) {
+                    warnings.push_back(understaffed_warning(cal, day, shift, roster.size(), cfg_.min_per_shift));
+                    SCHED_COUNT(stats_.understaffed_slots);
                 }
             }
+            if (pooled) fill_pool_.end_day();
         }
     }
 
+    // Seats over max_per_shift are counted per slot up front, and each overfull
+    // slot's surplus tail (the last assigned) moves out in one block. Each moved
+    // employee takes the first open slot in slot_adj_: another shift that day,
+    // then the next day. Whoever finds none gets one augmenting attempt: a
+    // member of a full neighbour moves on to one of its own open neighbours,
+    // freeing the seat. Only employees that attempt also fails are dropped.
+    void rebalance_max_cap(WeekState& st, vector<string>& warnings) {
+        SCHED_TIMER(stats_.rebalance_ns);
+        stats_.relocated_same_day = stats_.relocated_next_day = stats_.relocated_augmented = 0;
+        stats_.dropped = stats_.surplus_seats = 0;
+        stats_.moves.clear();
+        const int cap = cfg_.max_per_shift;
+        if (cap <= 0) return;
+        const int max_days = cfg_.max_days_per_employee;
+        const Calendar& cal = cfg_.calendar;
+        const size_t shifts = cal.num_shifts();
+        auto& rosters = st.sched.slots;
+
+        size_t surplus = 0;
+        spare_.resize(rosters.size());
+        for (size_t slot = 0; slot < rosters.size(); ++slot) {
+            spare_[slot] = cap - static_cast<int>(rosters[slot].size());
+            if (spare_[slot] < 0) surplus += static_cast<size_t>(-spare_[slot]);
+        }
+        if (surplus == 0) return;
+        SCHED_ADD(stats_.surplus_seats, surplus);
+
+        auto open_for = [&](uint32_t slot, EmpId emp) {
+            return spare_[slot] > 0 && !st.assigned_on_day.test(slot / shifts, emp);
+        };
+        auto place = [&](EmpId emp, uint32_t from, uint32_t to) {
+            st.assign(to / shifts, to % shifts, emp, max_days);
+            --spare_[to];
+            note_move(emp, from, to);
+        };
+
+        unplaced_.clear();
+        for (uint32_t slot = 0; slot < rosters.size(); ++slot) {
+            if (spare_[slot] >= 0) continue;
+            auto& roster = rosters[slot];
+            const size_t day = slot / shifts;
+            moved_.assign(make_move_iterator(roster.begin() + cap), make_move_iterator(roster.end()));
+            roster.resize(static_cast<size_t>(cap));
+            spare_[slot] = 0;
+
+            for (auto it = moved_.rbegin(); it != moved_.rend(); ++it) {
+                const EmpId emp = *it;
+                st.unassign(day, emp, max_days);
+                const auto targets = adjacent_slots(slot);
+                const auto to = find_if(targets.first, targets.second, [&](uint32_t t) { return open_for(t, emp); });
+                if (to == targets.second) {
+                    unplaced_.push_back({emp, slot});
+                    continue;
+                }
+                place(emp, slot, *to);
+                if (*to / shifts == day) SCHED_COUNT(stats_.relocated_same_day);
+                else SCHED_COUNT(stats_.relocated_next_day);
+            }
+        }
 
-    for (const auto& day : DAYS) {
-        for (const auto& shift : SHIFTS) {
-            int have = static_cast<int>(sched[day][shift].size());
-            int need = cfg.min_per_shift - have;
-            if (need <= 0) continue;
+        dead_end_.assign(unplaced_.empty() ? 0 : rosters.size(), false);
+        for (auto [emp, from] : unplaced_) {
+            if (augment(st, emp, from, place)) {
+                SCHED_COUNT(stats_.relocated_augmented);
+                continue;
+            }
+            SCHED_COUNT(stats_.dropped);
+            note_move(emp, from, RebalanceMove::NO_SLOT);
+            warnings.push_back(
+                "Note: Could not relocate " + table_.names[emp] + " from " + cal.days[from / shifts] + " " +
+                cal.shifts[from % shifts] + "; leaving unassigned."
+            );
+        }
+    }
 
-            vector<string> candidates;
-            candidates.reserve(employees.size());
-            for (const auto& e : employees) {
-                if (!assigned_on_day[day].count(e) && days_worked[e] < cfg.max_days_per_employee) {
-                    candidates.push_back(e);
+    // Length-two augmenting path from `from`: emp -> full neighbour b, one of b's
+    // members -> an open neighbour c of b. Every open c is tried, once per day, in
+    // adjacency order; same-day ones take any member of b, later days need a member
+    // who is off that day. Seats only close during this pass, so a b with no open
+    // neighbour left is a dead end for good.
+    //
+    // Two limits are heuristics rather than an exhaustive search: only the last
+    // AUGMENT_SCAN members of b are tried (the latest arrivals are often employees
+    // who work every day, and an unbounded scan could walk most of a large roster
+    // per attempt), and a b whose members all fail that scan is also treated as a
+    // dead end for the rest of the pass, although a later move could free one of
+    // them. Either can leave surplus that a full search would have placed.
+    static constexpr size_t AUGMENT_SCAN = 256;
+
+    template <typename Place>
+    bool augment(WeekState& st, EmpId emp, uint32_t from, Place&& place) {
+        const int max_days = cfg_.max_days_per_employee;
+        const size_t shifts = cfg_.calendar.num_shifts();
+        const auto hops = adjacent_slots(from);
+        for (auto b = hops.first; b != hops.second; ++b) {
+            const size_t day = *b / shifts;
+            if (dead_end_[*b] || st.assigned_on_day.test(day, emp)) continue;
+            auto& roster = st.sched.slots[*b];
+            const auto onward = adjacent_slots(*b);
+            size_t tried_day = numeric_limits<size_t>::max();
+            for (auto c = onward.first; c != onward.second; ++c) {
+                const size_t c_day = *c / shifts;
+                if (spare_[*c] <= 0 || c_day == tried_day) continue;
+                tried_day = c_day;
+                // Latest arrivals first, as in the direct pass; erasing near the back is cheap.
+                const size_t stop = roster.size() - min(roster.size(), AUGMENT_SCAN);
+                for (size_t i = roster.size(); i-- > stop;) {
+                    const EmpId other = roster[i];
+                    if (c_day != day && st.assigned_on_day.test(c_day, other)) continue;
+                    roster.erase(roster.begin() + static_cast<ptrdiff_t>(i));
+                    st.unassign(day, other, max_days);
+                    ++spare_[*b];
+                    place(other, *b, *c);
+                    place(emp, from, *b);
+                    return true;
                 }
             }
-            shuffle(candidates.begin(), candidates.end(), rng);
+            dead_end_[*b] = true;
+        }
+        return false;
+    }
 
-            int added = 0;
-            for (const auto& emp : candidates) {
-                if (cfg.max_per_shift > 0 && static_cast<int>(sched[day][shift].size()) >= cfg.max_per_shift) {
-                    break; 
+    // Rebalance targets of `slot`, in the order they are tried.
+    pair<const uint32_t*, const uint32_t*> adjacent_slots(size_t slot) const {
+        return {slot_adj_.data() + slot_adj_start_[slot], slot_adj_.data() + slot_adj_start_[slot + 1]};
+    }
+
+    void build_slot_adjacency() {
+        const Calendar& cal = cfg_.calendar;
+        slot_adj_.clear();
+        slot_adj_start_.assign(1, 0);
+        for (size_t day = 0; day < cal.num_days(); ++day) {
+            for (size_t shift = 0; shift < cal.num_shifts(); ++shift) {
+                for (size_t s2 = 0; s2 < cal.num_shifts(); ++s2) {
+                    if (s2 != shift) slot_adj_.push_back(static_cast<uint32_t>(cal.slot(day, s2)));
+                }
+                for (size_t s2 = 0; day + 1 < cal.num_days() && s2 < cal.num_shifts(); ++s2) {
+                    slot_adj_.push_back(static_cast<uint32_t>(cal.slot(day + 1, s2)));
                 }
-                sched[day][shift].push_back(emp);
-                assigned_on_day[day].insert(emp);
-                days_worked[emp] += 1;
-                added += 1;
-                if (added >= need) break;
+                slot_adj_start_.push_back(static_cast<uint32_t>(slot_adj_.size()));
             }
+        }
+    }
 
-            if (static_cast<int>(sched[day][shift].size()) < cfg.min_per_shift) {
-                warnings.push_back(
-                    "Warning: Could not meet min staffing for " + day + " " + shift +
-                    " (" + to_string(sched[day][shift].size()) + "/" + to_string(cfg.min_per_shift) +
-                    "). Consider more staff or relaxing caps."
-                );
+    void note_move(EmpId emp, uint32_t from, uint32_t to) {
+#if SCHEDULER_INSTRUMENT
+        stats_.moves.push_back({emp, from, to});
+#else
+        (void)emp;
+        (void)from;
+        (void)to;
+#endif
+    }
+
+    // Exact solve of schedule_cost() as a min-cost flow:
+    //   source -> employee (cap max_days) -> (employee, day) (cap 1) -> (day, shift)
+    //   -> sink, where each slot has a min_per_shift arc paying -COST_SHORTFALL and
+    //   the rest of its max_per_shift capacity at cost 0. Preferred shifts cost
+    //   rank - COST_MISSED, so honoring a preference always beats leaving the day empty.
+    // The incremental entry points simply re-solve in this mode.
+    void solve_optimal() {
+        const auto start = chrono::steady_clock::now();
+        const Calendar& cal = cfg_.calendar;
+        const size_t n = table_.size();
+        const size_t days = cal.num_days(), shifts = cal.num_shifts(), slots = cal.slots();
+        const size_t source = 0, emp_base = 1, day_base = emp_base + n, slot_base = day_base + n * days;
+        const size_t sink = slot_base + slots;
+
+        MinCostFlow flow(sink + 1);
+        vector<MinCostFlow::EdgeRef> edges(n * slots);     // [employee * slots + slot]
+        for (EmpId e = 0; e < n; ++e) {
+            if (!active_.test(e)) continue;
+            flow.add_edge(source, emp_base + e, max(0, cfg_.max_days_per_employee), 0);
+        }
+        long long constant = 0;
+        for (EmpId e = 0; e < n; ++e) {
+            if (!active_.test(e)) continue;
+            for (size_t d = 0; d < days; ++d) {
+                const size_t node = day_base + e * days + d;
+                flow.add_edge(emp_base + e, node, 1, 0);
+                const bool wants = !prefs_[e][d].empty();
+                if (wants) constant += COST_MISSED;
+                for (size_t s = 0; s < shifts; ++s) {
+                    const int rank = preference_rank(prefs_[e][d], s);
+                    long long c = rank >= 0 ? rank - COST_MISSED : COST_UNPREFERRED - (wants ? COST_MISSED : 0);
+                    edges[e * slots + cal.slot(d, s)] = flow.add_edge(node, slot_base + cal.slot(d, s), 1, c);
+                }
             }
         }
+        const int min_cap = max(0, cfg_.min_per_shift);
+        const int max_cap = cfg_.max_per_shift > 0 ? cfg_.max_per_shift : static_cast<int>(n);
+        for (size_t slot = 0; slot < slots; ++slot) {
+            flow.add_edge(slot_base + slot, sink, min(min_cap, max_cap), -COST_SHORTFALL);
+            if (max_cap > min_cap) flow.add_edge(slot_base + slot, sink, max_cap - min_cap, 0);
+            constant += COST_SHORTFALL * min_cap;
+        }
+
+        SolverReport& report = final_.report;
+        const bool finished = flow.run(source, sink, start + chrono::milliseconds(cfg_.optimal_budget_ms));
+        report.optimal_time = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+        if (!finished) {
+            report.timed_out = true;
+            final_.warnings.push_back("Note: Optimal solver exceeded its " + to_string(cfg_.optimal_budget_ms) +
+                                      " ms budget; keeping the greedy schedule.");
+            return;
+        }
+
+        IdSchedule sched(cal);
+        vector<int> days_worked(n, 0);
+        for (EmpId e = 0; e < n; ++e) {
+            if (!active_.test(e)) continue;
+            for (size_t slot = 0; slot < slots; ++slot) {
+                if (flow.flow(edges[e * slots + slot]) > 0) {
+                    sched.slots[slot].push_back(e);
+                    days_worked[e] += 1;
+                }
+            }
+        }
+        vector<string> warnings;
+        for (size_t d = 0; d < days; ++d) {
+            for (size_t s = 0; s < shifts; ++s) {
+                if (static_cast<int>(sched.at(d, s).size()) < cfg_.min_per_shift) {
+                    warnings.push_back(understaffed_warning(cal, d, s, sched.at(d, s).size(), cfg_.min_per_shift));
+                }
+            }
+        }
+
+        report.used = SolverMode::Optimal;
+        report.optimal_cost = flow.cost() + constant;
+        final_.sched = move(sched);
+        final_.days_worked = move(days_worked);
+        final_.warnings = move(warnings);
     }
 
-    if (cfg.max_per_shift > 0) {
-        for (const auto& day : DAYS) {
-            for (const auto& shift : SHIFTS) {
-                auto& vec = sched[day][shift];
-                while (static_cast<int>(vec.size()) > cfg.max_per_shift) {
-                    string emp = vec.back();
-                    vec.pop_back();
-                    if (assigned_on_day[day].count(emp)) {
-                        assigned_on_day[day].erase(emp);
-                        days_worked[emp] -= 1;
-                    }
-                    bool placed = false;
-
-                    for (const auto& s2 : SHIFTS) {
-                        if (s2 == shift) continue;
-                        if (static_cast<int>(sched[day][s2].size()) < cfg.max_per_shift &&
-                            !assigned_on_day[day].count(emp)) {
-                            sched[day][s2].push_back(emp);
-                            assigned_on_day[day].insert(emp);
-                            days_worked[emp] += 1;
-                            placed = true;
-                            break;
-                        }
-                    }
+    EmployeeTable table_;
+    IdPreferences prefs_;
+    Config cfg_;
+    size_t active_count_ = 0;
+
+    DenseBitset active_, carried_;
+    BitMatrix wants_day_;               // days x employees
+    BitMatrix prefers_;                 // (slot * MAX_RANK + rank) x employees
+
+    // Preference-phase state and its per-day checkpoints; index num_days() of
+    // both lists is the end of the calendar (carry-out and final counters).
+    WeekState pref_;
+    vector<vector<EmpId>> carry_over_next_day_;
+    vector<vector<int>> day_start_worked_;
+
+    vector<uint64_t> mask_;
+    FillPool fill_pool_;
+    vector<uint32_t> slot_adj_, slot_adj_start_;    // rebalance targets per slot, CSR
+    vector<int> spare_;                             // max_per_shift - roster size, per slot
+    vector<EmpId> moved_;
+    vector<pair<EmpId, uint32_t>> unplaced_;
+    vector<bool> dead_end_;                         // augment() found no path through the slot
+    vector<PreferenceCounters> day_counters_;
+    ScheduleStats stats_;
+    IdResult final_;
+};
 
-                    if (!placed) {
-                        auto itd = find(DAYS.begin(), DAYS.end(), day);
-                        if (itd != DAYS.end()) {
-                            size_t di = static_cast<size_t>(distance(DAYS.begin(), itd));
-                            if (di + 1 < DAYS.size()) {
-                                const string& next_day = DAYS[di + 1];
-                                for (const auto& s : SHIFTS) {
-                                    if (assigned_on_day[next_day].count(emp)) continue;
-                                    if (cfg.max_per_shift <= 0 ||
-                                        static_cast<int>(sched[next_day][s].size()) < cfg.max_per_shift) {
-                                        sched[next_day][s].push_back(emp);
-                                        assigned_on_day[next_day].insert(emp);
-                                        days_worked[emp] += 1;
-                                        placed = true;
-                                        break;
-                                    }
-                                }
-                            }
-                        }
-                    }
+IdResult schedule_ids(EmployeeTable table, IdPreferences prefs, const Config& cfg) {
+    return Scheduler(move(table), move(prefs), cfg).result();
+}
 
-                    if (!placed) {
-                        warnings.push_back(
-                            "Note: Could not relocate " + emp + " from " + day + " " + shift +
-                            "; leaving unassigned."
-                        );
-                    }
-                }
+// A long horizon (e.g. four weeks of cfg.calendar) solved as consecutive windows of
+// `window_days`, each an ordinary Scheduler over its slice of the calendar. Limits
+// such as max_days_per_employee apply per window, and window w is seeded with
+// random_seed + w. Employees still unplaced after a window's last day are carried
+// into the next window's first day. The windows keep their state between edits:
+// an edit re-solves the windows it touches, and later windows replay only while
+// the carry-over handed to them actually changes.
+class RollingScheduler {
+public:
+    RollingScheduler(EmployeeTable table, IdPreferences prefs, const Config& cfg, size_t window_days = DAYS.size())
+        : cfg_(cfg), window_days_(window_days), active_count_(table.size()), removed_(table.size()) {
+        const Calendar& cal = cfg_.calendar;
+        cal.validate();
+        if (window_days_ == 0) {
+            throw invalid_argument("A window must cover at least one day.");
+        }
+        prefs.resize(table.size());
+        for (const auto& per_day : prefs) {
+            if (!per_day.empty() && per_day.size() != cal.num_days()) {
+                throw invalid_argument("Preferences cover " + to_string(per_day.size()) + " days; the calendar has " +
+                                       to_string(cal.num_days()) + ".");
             }
         }
+        for (size_t first = 0; first < cal.num_days(); first += window_days_) {
+            const size_t count = min(window_days_, cal.num_days() - first);
+            Config window_cfg = cfg_;
+            window_cfg.calendar = cal.window(first, count);
+            window_cfg.random_seed = cfg_.random_seed + static_cast<unsigned int>(windows_.size());
+            IdPreferences slice(prefs.size());
+            for (size_t e = 0; e < prefs.size(); ++e) {
+                if (!prefs[e].empty()) slice[e].assign(prefs[e].begin() + first, prefs[e].begin() + first + count);
+            }
+            vector<EmpId> carry_in = windows_.empty() ? vector<EmpId>{} : windows_.back().carry_out();
+            windows_.emplace_back(table, move(slice), window_cfg, move(carry_in));
+        }
+        table_ = move(table);
+    }
+
+    void update_preference(const string& emp, const string& day, const PrefValue& ranked) {
+        const int d = cfg_.calendar.day_index(day);
+        if (d < 0) {
+            throw invalid_argument("Unknown day: " + day);
+        }
+        const size_t w = static_cast<size_t>(d) / window_days_;
+        windows_[w].update_preference(emp, day, ranked);
+        hand_on_carry(w, false);
     }
 
-    return {sched, warnings};
+    void remove_employee(const string& emp) {
+        auto it = table_.ids.find(emp);
+        if (it == table_.ids.end() || removed_[it->second]) {
+            throw invalid_argument("Unknown employee: " + emp);
+        }
+        // Every window must stay feasible; check them all before touching any.
+        for (const auto& w : windows_) {
+            Config window_cfg = cfg_;
+            window_cfg.calendar = w.calendar();
+            feasible_or_raise(active_count_ - 1, window_cfg);
+        }
+        removed_[it->second] = true;
+        --active_count_;
+        for (auto& w : windows_) w.remove_employee(emp);
+        hand_on_carry(0, true);
+    }
+
+    // The horizon's schedule, stitched from the windows (their slots are contiguous).
+    IdResult result() const {
+        IdResult out;
+        out.sched = IdSchedule(cfg_.calendar);
+        out.days_worked.assign(table_.size(), 0);
+        out.report.used = SolverMode::Optimal;
+        out.report.optimal_cost = 0;
+        size_t slot = 0;
+        for (const auto& w : windows_) {
+            const IdResult& r = w.result();
+            out.stats.add(r.stats, slot);
+            for (const auto& roster : r.sched.slots) out.sched.slots[slot++] = roster;
+            for (size_t e = 0; e < r.days_worked.size(); ++e) out.days_worked[e] += r.days_worked[e];
+            out.warnings.insert(out.warnings.end(), r.warnings.begin(), r.warnings.end());
+            if (r.report.used != SolverMode::Optimal) out.report.used = SolverMode::Greedy;
+            out.report.timed_out = out.report.timed_out || r.report.timed_out;
+            out.report.greedy_cost += r.report.greedy_cost;
+            out.report.optimal_cost = r.report.optimal_cost < 0 || out.report.optimal_cost < 0
+                                          ? -1 : out.report.optimal_cost + r.report.optimal_cost;
+            out.report.optimal_time += r.report.optimal_time;
+        }
+        return out;
+    }
+
+    size_t windows() const { return windows_.size(); }
+    const Scheduler& window(size_t w) const { return windows_[w]; }
+    const EmployeeTable& employees() const { return table_; }
+    const Calendar& calendar() const { return cfg_.calendar; }
+
+private:
+    // Passes each window's carry-out on to the next. After an edit confined to
+    // window `from`, an unchanged carry-in means every later window is unchanged.
+    void hand_on_carry(size_t from, bool every) {
+        for (size_t w = from + 1; w < windows_.size(); ++w) {
+            if (!windows_[w].set_carry_in(windows_[w - 1].carry_out()) && !every) return;
+        }
+    }
+
+    Config cfg_;
+    size_t window_days_;
+    size_t active_count_;
+    vector<bool> removed_;
+    EmployeeTable table_;
+    vector<Scheduler> windows_;
+};
+
+Schedule to_named_schedule(const IdSchedule& ids, const EmployeeTable& table,
+                           const Calendar& cal = default_calendar()) {
+    Schedule sched = empty_schedule(cal);
+    for (size_t d = 0; d < cal.num_days(); ++d) {
+        for (size_t s = 0; s < cal.num_shifts(); ++s) {
+            auto& names = sched[cal.days[d]][cal.shifts[s]];
+            names.reserve(ids.at(d, s).size());
+            for (EmpId e : ids.at(d, s)) names.push_back(table.names[e]);
+        }
+    }
+    return sched;
 }
 
-void print_schedule(const Schedule& schedule) {
-    cout << "\n=== Final Weekly Schedule ===\n";
-    for (const auto& day : DAYS) {
-        cout << "\n" << day << ":\n";
-        for (const auto& shift : SHIFTS) {
-            vector<string> names = schedule.at(day).at(shift);
-            sort(names.begin(), names.end());
-            cout << "  - " << setw(9) << left << string(1, toupper(shift[0])) + shift.substr(1) << " : ";
-            if (names.empty()) {
-                cout << "(none)";
-            } else {
-                for (size_t i = 0; i < names.size(); ++i) {
-                    if (i) cout << ", ";
-                    cout << names[i];
-                }
+pair<Schedule, vector<string>> schedule_employees(
+    vector<string> employees,
+    const RawPreferences& raw_preferences,
+    Config cfg = Config(),
+    ScheduleStats* stats = nullptr
+) {
+    Scheduler scheduler(employees, raw_preferences, cfg);
+    if (stats) *stats = scheduler.result().stats;
+    return {to_named_schedule(scheduler.result().sched, scheduler.employees(), cfg.calendar),
+            scheduler.result().warnings};
+}
+
+struct ScheduleJob {
+    vector<string> employees;
+    RawPreferences preferences;
+    Config cfg;
+};
+
+struct ScheduleJobResult {
+    Schedule schedule;
+    vector<string> warnings;
+    ScheduleStats stats;
+    string error;                       // set instead of schedule when the job threw
+    chrono::nanoseconds elapsed{0};
+};
+
+// Fixed-size pool; each worker owns a deque, pops from its front and steals from the back of others.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned threads) : queues_(max(1u, threads)) {
+        for (size_t i = 0; i < queues_.size(); ++i) {
+            workers_.emplace_back([this, i] { run(i); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            lock_guard<mutex> lk(mu_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) t.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void submit(function<void()> task) {
+        Queue& q = queues_[next_.fetch_add(1, memory_order_relaxed) % queues_.size()];
+        {
+            lock_guard<mutex> qlk(q.mu);
+            q.tasks.push_back(move(task));
+            lock_guard<mutex> lk(mu_);
+            ++queued_;
+            ++pending_;
+        }
+        cv_.notify_one();
+    }
+
+    void wait_idle() {
+        unique_lock<mutex> lk(mu_);
+        idle_cv_.wait(lk, [this] { return pending_ == 0; });
+    }
+
+private:
+    struct Queue {
+        mutex mu;
+        deque<function<void()>> tasks;
+    };
+
+    // Called with q.mu held; keeps queued_ equal to the number of tasks sitting in queues.
+    void take(Queue& q, function<void()>& out, bool front) {
+        if (front) {
+            out = move(q.tasks.front());
+            q.tasks.pop_front();
+        } else {
+            out = move(q.tasks.back());
+            q.tasks.pop_back();
+        }
+        lock_guard<mutex> lk(mu_);
+        --queued_;
+    }
+
+    bool try_pop(size_t self, function<void()>& out) {
+        for (size_t k = 0; k < queues_.size(); ++k) {
+            Queue& q = queues_[(self + k) % queues_.size()];
+            lock_guard<mutex> lk(q.mu);
+            if (!q.tasks.empty()) {
+                take(q, out, k == 0);
+                return true;
             }
-            cout << "\n";
         }
+        return false;
     }
+
+    void run(size_t self) {
+        function<void()> task;
+        for (;;) {
+            if (try_pop(self, task)) {
+                task();
+                task = nullptr;
+                lock_guard<mutex> lk(mu_);
+                if (--pending_ == 0) idle_cv_.notify_all();
+                continue;
+            }
+            unique_lock<mutex> lk(mu_);
+            cv_.wait(lk, [this] { return stopping_ || queued_ > 0; });
+            if (stopping_ && queued_ == 0) return;
+        }
+    }
+
+    vector<Queue> queues_;
+    vector<thread> workers_;
+    atomic<size_t> next_{0};
+    mutex mu_;
+    condition_variable cv_, idle_cv_;
+    size_t queued_ = 0;                 // tasks waiting in a queue
+    size_t pending_ = 0;                // queued plus currently running
+    bool stopping_ = false;
+};
+
+// Solves independent sites concurrently. Job i runs with seed cfg.random_seed + i,
+// so results do not depend on thread count or completion order.
+vector<ScheduleJobResult> schedule_batch(const vector<ScheduleJob>& jobs,
+                                         unsigned threads = thread::hardware_concurrency()) {
+    vector<ScheduleJobResult> results(jobs.size());
+    WorkStealingPool pool(threads);
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        pool.submit([&jobs, &results, i] {
+            const ScheduleJob& job = jobs[i];
+            ScheduleJobResult& out = results[i];
+            Config cfg = job.cfg;
+            cfg.random_seed = job.cfg.random_seed + static_cast<unsigned int>(i);
+
+            auto start = chrono::steady_clock::now();
+            try {
+                Scheduler scheduler(job.employees, job.preferences, cfg);
+                const IdResult& res = scheduler.result();
+                out.schedule = to_named_schedule(res.sched, scheduler.employees(), cfg.calendar);
+                out.warnings = res.warnings;
+                out.stats = res.stats;
+            } catch (const exception& e) {
+                out.error = e.what();
+            }
+            out.elapsed = chrono::steady_clock::now() - start;
+        });
+    }
+    pool.wait_idle();
+    return results;
+}
+
+static void render_shift_row(ReportBuffer& out, const string& shift, const vector<string_view>& names) {
+    string label = shift;
+    label[0] = static_cast<char>(toupper(static_cast<unsigned char>(label[0])));
+    out.put("  - ").padded(label, 9).put(" : ");
+    if (names.empty()) {
+        out.put("(none)");
+    } else {
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (i) out.put(", ");
+            out.put(names[i]);
+        }
+    }
+    out.put('\n');
 }
 
+void print_schedule(const Schedule& schedule, const Calendar& cal = default_calendar()) {
+    ReportBuffer out;
+    out.put("\n=== Final Weekly Schedule ===\n");
+    vector<string_view> names;
+    for (const auto& day : cal.days) {
+        out.put('\n').put(day).put(":\n");
+        for (const auto& shift : cal.shifts) {
+            names.assign(schedule.at(day).at(shift).begin(), schedule.at(day).at(shift).end());
+            sort(names.begin(), names.end());
+            render_shift_row(out, shift, names);
+        }
+    }
+    out.flush(stdout);
+}
+
+// Names are ordered through a rank table built once, so each slot sorts small
+// integers instead of copying and comparing strings.
+void print_schedule(const IdSchedule& schedule, const EmployeeTable& table, const Calendar& cal = default_calendar()) {
+    vector<EmpId> by_name(table.size());
+    for (EmpId e = 0; e < by_name.size(); ++e) by_name[e] = e;
+    sort(by_name.begin(), by_name.end(), [&](EmpId a, EmpId b) { return table.names[a] < table.names[b]; });
+    vector<uint32_t> rank(table.size());
+    for (uint32_t r = 0; r < by_name.size(); ++r) rank[by_name[r]] = r;
+
+    ReportBuffer out;
+    out.put("\n=== Final Weekly Schedule ===\n");
+    vector<uint32_t> ranks;
+    vector<string_view> names;
+    for (size_t d = 0; d < cal.num_days(); ++d) {
+        out.put('\n').put(cal.days[d]).put(":\n");
+        for (size_t s = 0; s < cal.num_shifts(); ++s) {
+            ranks.clear();
+            for (EmpId e : schedule.at(d, s)) ranks.push_back(rank[e]);
+            sort(ranks.begin(), ranks.end());
+            names.clear();
+            for (uint32_t r : ranks) names.push_back(table.names[by_name[r]]);
+            render_shift_row(out, cal.shifts[s], names);
+        }
+    }
+    out.flush(stdout);
+}
 
 pair<vector<string>, RawPreferences> example_dataset() {
     vector<string> employees = {
@@ -410,17 +1787,27 @@ pair<vector<string>, RawPreferences> example_dataset() {
 }
 
 
-int main() {
+#ifndef SCHEDULER_NO_MAIN
+int main(int argc, char** argv) {
     try {
-        auto [employees, prefs] = example_dataset();
         Config cfg;
         cfg.min_per_shift = 2;
         cfg.max_per_shift = 4;  
         cfg.max_days_per_employee = 5;
         cfg.random_seed = 7;
 
-        auto [schedule, warnings] = schedule_employees(employees, prefs, cfg);
-        print_schedule(schedule);
+        auto build = [&]() {
+            if (argc > 1) {
+                Roster roster = load_preferences_csv(argv[1]);
+                return Scheduler(move(roster.table), move(roster.prefs), cfg);
+            }
+            auto [employees, prefs] = example_dataset();
+            return Scheduler(employees, prefs, cfg);
+        };
+        Scheduler scheduler = build();
+        const IdResult& result = scheduler.result();
+        const auto& warnings = result.warnings;
+        print_schedule(result.sched, scheduler.employees(), scheduler.calendar());
 
         if (!warnings.empty()) {
             cout << "\nNotes & Warnings:\n";
@@ -428,9 +1815,13 @@ int main() {
                 cout << " - " << w << "\n";
             }
         }
+#if SCHEDULER_INSTRUMENT
+        cout << "\nStats: " << result.stats.to_json() << "\n";
+#endif
     } catch (const exception& e) {
         cerr << "Error: " << e.what() << "\n";
         return 1;
     }
     return 0;
 }
+#endif
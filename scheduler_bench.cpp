@@ -0,0 +1,223 @@
+// Synthetic-roster benchmark for scheduler.cpp: times each solver phase separately.
+//
+// Build: make scheduler_bench
+// Usage: scheduler_bench [--sizes 1000,10000,100000] [--density 0.6] [--skew 1.0]
+//                        [--weeks 1] [--shifts 3] [common bench_harness.h options]
+//   density : probability that an employee states a preference for a given day
+//   skew    : shift popularity falls off as 1/(rank+1)^skew (0 = uniform)
+//   weeks   : horizon length; with more than one week a window-per-week rolling solve is also timed
+//   shifts  : shifts per day (3 uses the default Morning/Afternoon/Evening labels)
+
+#define SCHEDULER_NO_MAIN
+#include "scheduler.cpp"
+
+#include "bench_harness.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+#include <sys/resource.h>
+
+static atomic<size_t> g_allocs{0};
+
+// Kept out of line so GCC does not pair inlined malloc/free against new/delete callers.
+__attribute__((noinline)) void* operator new(size_t n) {
+    g_allocs.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(n ? n : 1)) return p;
+    throw bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+
+static size_t alloc_count() { return g_allocs.load(memory_order_relaxed); }
+
+class SchedulerBench {
+public:
+    static void preference_phase(Scheduler& s) { s.replay_from(0, s.calendar().num_days()); }
+    static WeekState preference_state(const Scheduler& s) { return s.pref_; }
+    static void fill(Scheduler& s, WeekState& st, vector<string>& w) { s.fill_min_staffing(st, w); }
+    static void rebalance(Scheduler& s, WeekState& st, vector<string>& w) { s.rebalance_max_cap(st, w); }
+};
+
+struct RosterSpec {
+    size_t employees = 1000;
+    double density = 0.6;
+    double skew = 1.0;
+    unsigned seed = 1;
+    Calendar calendar;
+};
+
+pair<vector<string>, RawPreferences> synthetic_roster(const RosterSpec& spec) {
+    mt19937 rng(spec.seed);
+    uniform_real_distribution<double> coin(0.0, 1.0);
+
+    const Calendar& cal = spec.calendar;
+    vector<double> weight(cal.num_shifts());
+    for (size_t s = 0; s < weight.size(); ++s) weight[s] = 1.0 / pow(static_cast<double>(s + 1), spec.skew);
+
+    vector<string> employees;
+    employees.reserve(spec.employees);
+    RawPreferences prefs;
+    prefs.reserve(spec.employees);
+    for (size_t i = 0; i < spec.employees; ++i) {
+        employees.push_back("emp" + to_string(i));
+        auto& per_day = prefs[employees.back()];
+        for (const auto& day : cal.days) {
+            if (coin(rng) >= spec.density) continue;
+            // Draw 1-3 distinct shifts, most popular first on average.
+            vector<double> w = weight;
+            vector<string> ranked;
+            const size_t k = 1 + rng() % min<size_t>(MAX_RANK, cal.num_shifts());
+            for (size_t r = 0; r < k; ++r) {
+                discrete_distribution<size_t> pick(w.begin(), w.end());
+                const size_t s = pick(rng);
+                w[s] = 0.0;
+                ranked.push_back(cal.shifts[s]);
+            }
+            if (ranked.size() == 1) {
+                per_day[day] = ranked.front();
+            } else {
+                per_day[day] = move(ranked);
+            }
+        }
+    }
+    return {employees, prefs};
+}
+
+static long peak_rss_kb() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+static vector<size_t> parse_sizes(const char* arg) {
+    vector<size_t> sizes;
+    for (string_view rest = arg; !rest.empty();) {
+        const size_t comma = rest.find(',');
+        sizes.push_back(static_cast<size_t>(strtoull(string(rest.substr(0, comma)).c_str(), nullptr, 10)));
+        rest = (comma == string_view::npos) ? string_view{} : rest.substr(comma + 1);
+    }
+    return sizes;
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = {1000, 10000, 100000};
+    RosterSpec spec;
+    size_t weeks = 1;
+    size_t shifts = SHIFTS.size();
+    bench_session session;
+    bench_session_init(&session, "scheduler");
+    session.cfg.reps = 3;
+    session.cfg.alloc_count = alloc_count;
+    for (int i = 1; i < argc; ++i) {
+        const int common = bench_session_option(&session, argc, argv, &i);
+        if (common > 0) continue;
+        const string flag = argv[i];
+        const bool valued = common == 0 && i + 1 < argc;
+        if (valued && flag == "--sizes") sizes = parse_sizes(argv[++i]);
+        else if (valued && flag == "--density") spec.density = atof(argv[++i]);
+        else if (valued && flag == "--skew") spec.skew = atof(argv[++i]);
+        else if (valued && flag == "--weeks") weeks = static_cast<size_t>(strtoull(argv[++i], nullptr, 10));
+        else if (valued && flag == "--shifts") shifts = static_cast<size_t>(strtoull(argv[++i], nullptr, 10));
+        else {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    spec.seed = static_cast<unsigned>(session.seed);
+    vector<string> shift_labels = SHIFTS;
+    if (shifts != SHIFTS.size()) {
+        shift_labels.clear();
+        for (size_t s = 0; s < shifts; ++s) shift_labels.push_back("Shift" + to_string(s + 1));
+    }
+    spec.calendar = Calendar::weekly(weeks, shift_labels);
+
+    if (session.table) {
+        printf("density=%.2f skew=%.2f weeks=%zu shifts=%zu\n", spec.density, spec.skew, weeks, shifts);
+    }
+    if (!bench_session_start(&session)) return 1;
+
+    try {
+        for (size_t n : sizes) {
+            spec.employees = n;
+            auto [employees, raw] = synthetic_roster(spec);
+            // Every phase is reported per employee, so sizes compare directly.
+            auto report = [&](const char* phase, const bench_result& r) { bench_record(&session, phase, n, &r); };
+            auto measure = [&](auto&&... fns) { return bench_measure(session.cfg, n, fns...); };
+
+            // Size caps so every slot needs roughly 80-110% of the average supply.
+            Config cfg;
+            cfg.calendar = spec.calendar;
+            cfg.max_days_per_employee *= static_cast<int>(weeks);
+            const double avg = static_cast<double>(n) * cfg.max_days_per_employee / cfg.calendar.slots();
+            cfg.min_per_shift = max(2, static_cast<int>(avg * 0.8));
+            cfg.max_per_shift = max(cfg.min_per_shift, static_cast<int>(avg * 1.1));
+            cfg.random_seed = spec.seed;
+
+            report("normalize_preferences", measure([&] { normalize_preferences(raw, cfg.calendar); }));
+
+            Roster roster;
+            report("intern+normalize_ids", measure([&] {
+                roster.table = intern_employees(employees);
+                roster.prefs = normalize_preferences_ids(raw, roster.table, cfg.calendar);
+            }));
+
+            Scheduler scheduler(roster.table, roster.prefs, cfg);
+            report("rank+fallback passes", measure([&] { SchedulerBench::preference_phase(scheduler); }));
+
+            WeekState st;
+            vector<string> warnings;
+            auto reset_to = [&](const WeekState& from) {
+                return [&st, &warnings, src = &from] {
+                    st = *src;
+                    warnings.clear();
+                };
+            };
+            const WeekState preferred = SchedulerBench::preference_state(scheduler);
+            report("min-staffing fill", measure(reset_to(preferred), [&] {
+                SchedulerBench::fill(scheduler, st, warnings);
+            }));
+
+            const WeekState filled = st;
+            report("max-cap rebalance", measure(reset_to(filled), [&] {
+                SchedulerBench::rebalance(scheduler, st, warnings);
+            }));
+
+            // Top every other slot up to ~10% past max_per_shift with whoever is off that day.
+            WeekState overfull = filled;
+            {
+                const Calendar& cal = cfg.calendar;
+                const size_t target = static_cast<size_t>(cfg.max_per_shift + cfg.max_per_shift / 10 + 1);
+                EmpId next = 0;
+                for (size_t slot = 0; slot < cal.slots(); slot += 2) {
+                    const size_t day = slot / cal.num_shifts();
+                    for (size_t tries = 0; overfull.sched.slots[slot].size() < target && tries < n; ++tries) {
+                        const EmpId emp = next++ % n;
+                        if (overfull.assigned_on_day.test(day, emp)) continue;
+                        overfull.assign(day, slot % cal.num_shifts(), emp, cfg.max_days_per_employee);
+                    }
+                }
+            }
+            report("overfull rebalance", measure(reset_to(overfull), [&] {
+                SchedulerBench::rebalance(scheduler, st, warnings);
+            }));
+
+            report("full solve", measure([&] { Scheduler s(roster.table, roster.prefs, cfg); }));
+            if (weeks > 1) {
+                // Per-week caps, so every window sees the same pressure as the one-week bench.
+                Config weekly_cfg = cfg;
+                weekly_cfg.max_days_per_employee /= static_cast<int>(weeks);
+                report("rolling solve", measure([&] { RollingScheduler r(roster.table, roster.prefs, weekly_cfg); }));
+            }
+
+            bench_note(&session, "peak_rss_kb", n, static_cast<double>(peak_rss_kb()));
+        }
+    } catch (const exception& e) {
+        fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+    }
+    return bench_session_finish(&session);
+}
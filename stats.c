@@ -1,23 +1,38 @@
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STATS_HAVE_AVX2 1
+#endif
+
+/*
+  Command-line entry points, reached only from main(). Built with
+  STATS_NO_MAIN (e.g. by stats_bench.c) they are unused, and that is expected.
+*/
+#define STATS_MAIN_ONLY __attribute__((unused))
 
 /* ---------- Utilities ---------- */
 
-static void die_usage(const char *prog) {
-    fprintf(stderr, "Usage: %s <int1> <int2> ...\n", prog);
+STATS_MAIN_ONLY static void die_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [--type i32|i64|f64] [--sort] <v1> <v2> ...\n", prog);
+    fprintf(stderr, "       %s --stream [FILE|-] [--type i32|i64|f64] [--max-distinct N] [--threads N]\n", prog);
+    fprintf(stderr, "         [--format text|i32|i64|f64] [--save-summary OUT]   (binary: raw little-endian, FILE only)\n");
+    fprintf(stderr, "       %s --merge [--max-distinct N] [--save-summary OUT] SUMMARY...\n", prog);
     fprintf(stderr, "Example: %s 1 2 2 3 4 4 4 5\n", prog);
     exit(EXIT_FAILURE);
 }
 
-static int cmp_int(const void *a, const void *b) {
-    const int ai = *(const int *)a;
-    const int bi = *(const int *)b;
-    return (ai > bi) - (ai < bi);
-}
-
 /* Parse a single integer from a string with strict checking. */
 static int parse_int_strict(const char *s, int *out) {
     char *end = NULL;
@@ -29,116 +44,1517 @@ static int parse_int_strict(const char *s, int *out) {
     return 1;
 }
 
-/* ---------- Core statistics ---------- */
+static int parse_int64_strict(const char *s, int64_t *out) {
+    char *end = NULL;
+    errno = 0;
+    long long v = strtoll(s, &end, 10);
+    if (errno != 0 || end == s || *end != '\0') return 0;  // invalid or out of range
+    *out = (int64_t)v;
+    return 1;
+}
+
+/* Finite values only: nan, inf and overflowing literals are rejected. -0 reads as 0. */
+static int parse_double_strict(const char *s, double *out) {
+    char *end = NULL;
+    errno = 0;
+    const double v = strtod(s, &end);
+    if (end == s || *end != '\0' || !isfinite(v)) return 0;
+    if (errno == ERANGE && fabs(v) > 1.0) return 0;       // overflow; gradual underflow is fine
+    *out = v == 0 ? 0.0 : v;
+    return 1;
+}
+
+/*
+  Same acceptance as the strtol-based parsers for a token with no surrounding
+  whitespace: optional sign, decimal digits, value within 'limit' (one more
+  when negative). Eight digits at a time are validated and combined with SWAR
+  arithmetic on a 64-bit word, so a typical token costs a couple of
+  multiplies and no per-digit branches.
+*/
+static uint64_t load_le64(const char *p) {
+    uint64_t w;
+    memcpy(&w, p, sizeof w);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+
+static int eight_digits(uint64_t w) {
+    return (((w + 0x4646464646464646ull) | (w - 0x3030303030303030ull)) & 0x8080808080808080ull) == 0;
+}
+
+static uint32_t eight_digits_value(uint64_t w) {
+    w -= 0x3030303030303030ull;
+    w = (w * 10) + (w >> 8);                  // pairs of digits
+    w = (((w & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+         (((w >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+    return (uint32_t)w;
+}
 
-static double mean(const int *a, size_t n) {
-    long long sum = 0;              // avoid overflow for moderate n
-    for (size_t i = 0; i < n; ++i) {
-        sum += a[i];
+static int parse_decimal_fast(const char *s, size_t len, uint64_t limit, int *neg_out, uint64_t *mag_out) {
+    const char *end = s + len;
+    int neg = 0;
+    if (s < end && (*s == '-' || *s == '+')) neg = *s++ == '-';
+    if (s == end) return 0;
+    while (end - s > 1 && *s == '0') ++s;     // leading zeros do not count toward the limit
+    if (end - s > 19) return 0;               // more significant digits than INT64_MIN has
+    uint64_t v = 0;
+    while (end - s >= 8) {
+        const uint64_t w = load_le64(s);
+        if (!eight_digits(w)) return 0;
+        v = v * 100000000u + eight_digits_value(w);
+        s += 8;
+    }
+    for (; s < end; ++s) {
+        const unsigned d = (unsigned)(unsigned char)*s - '0';
+        if (d > 9) return 0;
+        v = v * 10 + d;
     }
-    return (double)sum / (double)n;
+    if (v > limit + (uint64_t)neg) return 0;
+    *neg_out = neg;
+    *mag_out = v;
+    return 1;
 }
 
-/* Assumes 'sorted' is sorted ascending. */
-static double median_sorted(const int *sorted, size_t n) {
-    if (n % 2 == 1) {
-        return (double)sorted[n / 2];
-    } else {
-        int left = sorted[n / 2 - 1];
-        int right = sorted[n / 2];
-        return (left + right) / 2.0;
+static int parse_int_fast(const char *s, size_t len, int *out) {
+    int neg;
+    uint64_t v;
+    if (!parse_decimal_fast(s, len, INT_MAX, &neg, &v)) return 0;
+    *out = neg ? (int)-(int64_t)v : (int)v;
+    return 1;
+}
+
+static int parse_int64_fast(const char *s, size_t len, int64_t *out) {
+    int neg;
+    uint64_t v;
+    if (!parse_decimal_fast(s, len, INT64_MAX, &neg, &v)) return 0;
+    *out = !neg ? (int64_t)v : v > (uint64_t)INT64_MAX ? INT64_MIN : -(int64_t)v;
+    return 1;
+}
+
+/* ---------- Value types ---------- */
+
+/*
+  Element types the kernels are generated for. The streaming state, the
+  count tables and the sketches hold every type as an int64 key whose order
+  matches the value order (doubles: IEEE bits with the negative half
+  flipped), so they need no per-type code of their own.
+*/
+typedef enum { TYPE_I32, TYPE_I64, TYPE_F64 } value_type;
+
+static const char *value_type_noun(value_type t) {
+    return t == TYPE_F64 ? "number" : "integer";
+}
+
+static size_t value_type_size(value_type t) {
+    return t == TYPE_I32 ? sizeof(int) : t == TYPE_I64 ? sizeof(int64_t) : sizeof(double);
+}
+
+static int64_t key_f64(double v) {
+    uint64_t u;
+    if (v == 0) v = 0.0;                      // -0.0 and 0.0 are one value
+    memcpy(&u, &v, sizeof u);
+    return (int64_t)(u >> 63 ? u ^ (uint64_t)INT64_MAX : u);
+}
+
+static double from_key_f64(int64_t k) {
+    const uint64_t u = k < 0 ? (uint64_t)k ^ (uint64_t)INT64_MAX : (uint64_t)k;
+    double v;
+    memcpy(&v, &u, sizeof v);
+    return v;
+}
+
+static int key_valid(value_type t, int64_t k) {
+    if (t == TYPE_I32) return k >= INT_MIN && k <= INT_MAX;
+    if (t == TYPE_F64) return isfinite(from_key_f64(k));
+    return 1;
+}
+
+/* Exact running total for integer sums beyond int64 (e.g. 1e10 large values). */
+#ifdef __SIZEOF_INT128__
+__extension__ typedef __int128 wide_sum;
+#else
+typedef long double wide_sum;   /* exact to 64 bits of mantissa where long double is x87 */
+#endif
+
+static double midpoint_f64(double a, double b) {
+    const double m = (a + b) / 2.0;
+    return isfinite(m) ? m : a / 2.0 + b / 2.0;
+}
+
+/* (a + b) / 2 for two keys of type t, rounded once. */
+static double key_midpoint(value_type t, int64_t a, int64_t b) {
+    if (t == TYPE_F64) return midpoint_f64(from_key_f64(a), from_key_f64(b));
+    return (double)((wide_sum)a + b) / 2.0;
+}
+
+/* Shortest of %.15g .. %.17g that reads back as the same double. */
+static void print_double(double v) {
+    char buf[32];
+    for (int p = 15; p <= 17; ++p) {
+        snprintf(buf, sizeof buf, "%.*g", p, v);
+        if (strtod(buf, NULL) == v) break;
+    }
+    fputs(buf, stdout);
+}
+
+static void print_key(value_type t, int64_t k) {
+    if (t == TYPE_F64) print_double(from_key_f64(k));
+    else printf("%lld", (long long)k);
+}
+
+/* ---------- Reductions ---------- */
+
+/*
+  Running sum for any element type: integers add into 'exact', doubles into
+  the Neumaier pair (hi, lo). The unused part stays zero, so the mean and
+  the merge do not need to know the type.
+
+  The pair is held at a power-of-two scale, so the double sum is
+  (hi + lo) * 2^scale. Before a partial sum could leave the finite range, the
+  pair is scaled down by 2^-SUM_RESCALE_STEP (exact, bar underflow in lo).
+  Finite inputs therefore never produce an inf or an inf - inf correction,
+  and the mean is divided out before the scale is applied. Infinite or NaN
+  inputs are added as they are and propagate to the mean.
+*/
+typedef struct {
+    wide_sum exact;
+    double hi, lo;
+    int scale;
+} stats_sum;
+
+#define STATS_SUM_ZERO {0, 0.0, 0.0, 0}
+#define SUM_RESCALE_LIMIT 0x1p960
+#define SUM_RESCALE_STEP 64
+
+static void stats_sum_rescale(stats_sum *s, int scale) {
+    s->hi = ldexp(s->hi, s->scale - scale);
+    s->lo = ldexp(s->lo, s->scale - scale);
+    s->scale = scale;
+}
+
+/* Adds x * 2^scale. */
+static void neumaier_add_scaled(stats_sum *s, double x, int scale) {
+    if (scale > s->scale) stats_sum_rescale(s, scale);
+    else if (scale < s->scale) x = ldexp(x, scale - s->scale);
+    if (!isfinite(x) || !isfinite(s->hi)) {
+        s->hi += x;
+        return;
+    }
+    while (fabs(s->hi) + fabs(x) >= SUM_RESCALE_LIMIT) {
+        stats_sum_rescale(s, s->scale + SUM_RESCALE_STEP);
+        x = ldexp(x, -SUM_RESCALE_STEP);
     }
+    const double t = s->hi + x;
+    if (fabs(s->hi) >= fabs(x)) s->lo += (s->hi - t) + x;
+    else s->lo += (x - t) + s->hi;
+    s->hi = t;
+}
+
+static void neumaier_add(stats_sum *s, double x) {
+    neumaier_add_scaled(s, x, 0);
+}
+
+static double stats_sum_mean(const stats_sum *s, size_t n) {
+    return (double)s->exact / (double)n + ldexp((s->hi + s->lo) / (double)n, s->scale);
+}
+
+static void stats_sum_merge(stats_sum *dst, const stats_sum *src) {
+    dst->exact += src->exact;
+    neumaier_add_scaled(dst, src->hi, src->scale);
+    neumaier_add_scaled(dst, src->lo, src->scale);
 }
 
 /*
-  Compute modes from a sorted array.
-  - 'modes_out' must have capacity at least n.
-  - Returns the number of modes, and writes max frequency to *maxfreq_out.
+  Sums and min/max over blocks of each element type. The int32 AVX2 paths
+  widen to 64-bit lanes, so every path computes the same exact integer and
+  the choice of path (or of thread split) never changes a result. Dispatch
+  is at run time.
 */
-static size_t modes_from_sorted(const int *sorted, size_t n,
-                                int *modes_out, int *maxfreq_out) {
-    if (n == 0) { *maxfreq_out = 0; return 0; }
+#define DEFINE_MINMAX_SCALAR(NAME, T)                                   \
+    static void NAME(const T *a, size_t n, T *min_out, T *max_out) {    \
+        T lo = a[0], hi = a[0];                                         \
+        for (size_t i = 1; i < n; ++i) {                                \
+            if (a[i] < lo) lo = a[i];                                   \
+            if (a[i] > hi) hi = a[i];                                   \
+        }                                                               \
+        *min_out = lo;                                                  \
+        *max_out = hi;                                                  \
+    }
+
+DEFINE_MINMAX_SCALAR(minmax_i32_scalar, int)
+DEFINE_MINMAX_SCALAR(minmax_i64, int64_t)
+DEFINE_MINMAX_SCALAR(minmax_f64, double)
 
-    int maxf = 0;
-    size_t modes_count = 0;
+static int64_t sum_i32_scalar(const int *a, size_t n) {
+    int64_t s = 0;
+    for (size_t i = 0; i < n; ++i) s += a[i];
+    return s;
+}
 
+#ifdef STATS_HAVE_AVX2
+__attribute__((target("avx2")))
+static int64_t sum_i32_avx2(const int *a, size_t n) {
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
     size_t i = 0;
-    while (i < n) {
-        int value = sorted[i];
-        size_t count = 1;
-        while (i + count < n && sorted[i + count] == value) ++count;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_epi64(acc0, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(a + i))));
+        acc1 = _mm256_add_epi64(acc1, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(a + i + 4))));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(acc0, acc1));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sum_i32_scalar(a + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void minmax_i32_avx2(const int *a, size_t n, int *min_out, int *max_out) {
+    if (n < 8) { minmax_i32_scalar(a, n, min_out, max_out); return; }
+    __m256i lo = _mm256_loadu_si256((const __m256i *)a), hi = lo;
+    size_t i = 8;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)(a + i));
+        lo = _mm256_min_epi32(lo, v);
+        hi = _mm256_max_epi32(hi, v);
+    }
+    int l[8], h[8];
+    _mm256_storeu_si256((__m256i *)l, lo);
+    _mm256_storeu_si256((__m256i *)h, hi);
+    int rlo = l[0], rhi = h[0];
+    for (int k = 1; k < 8; ++k) {
+        if (l[k] < rlo) rlo = l[k];
+        if (h[k] > rhi) rhi = h[k];
+    }
+    for (; i < n; ++i) {
+        if (a[i] < rlo) rlo = a[i];
+        if (a[i] > rhi) rhi = a[i];
+    }
+    *min_out = rlo;
+    *max_out = rhi;
+}
+#endif
+
+static int64_t sum_i32(const int *a, size_t n) {
+#ifdef STATS_HAVE_AVX2
+    if (__builtin_cpu_supports("avx2")) return sum_i32_avx2(a, n);
+#endif
+    return sum_i32_scalar(a, n);
+}
+
+/* Requires n > 0. */
+static void minmax_i32(const int *a, size_t n, int *min_out, int *max_out) {
+#ifdef STATS_HAVE_AVX2
+    if (__builtin_cpu_supports("avx2")) { minmax_i32_avx2(a, n, min_out, max_out); return; }
+#endif
+    minmax_i32_scalar(a, n, min_out, max_out);
+}
+
+static void sum_into_i32(stats_sum *s, const int *a, size_t n) {
+    s->exact += sum_i32(a, n);
+}
+
+static void sum_into_i64(stats_sum *s, const int64_t *a, size_t n) {
+    wide_sum t = 0;
+    for (size_t i = 0; i < n; ++i) t += a[i];
+    s->exact += t;
+}
+
+/*
+  Blocks run the plain Neumaier loop first. A partial sum that overflows stays
+  non-finite to the end of the block, so a non-finite pair afterwards means
+  the block is redone from the saved pair through neumaier_add's rescaling.
+  A scaled pair takes its inputs times 2^-scale, which is exact short of
+  underflow, the same as neumaier_add.
+*/
+#define SUM_F64_BLOCK 1024
+
+static void sum_into_f64(stats_sum *s, const double *a, size_t n) {
+    for (size_t i = 0; i < n; i += SUM_F64_BLOCK) {
+        const size_t m = n - i < SUM_F64_BLOCK ? n - i : SUM_F64_BLOCK;
+        const double *b = a + i;
+        if (isfinite(s->hi)) {
+            const double f = ldexp(1.0, -s->scale);
+            double hi = s->hi, lo = s->lo;
+            for (size_t j = 0; j < m; ++j) {
+                const double x = b[j] * f, t = hi + x;
+                if (fabs(hi) >= fabs(x)) lo += (hi - t) + x;
+                else lo += (x - t) + hi;
+                hi = t;
+            }
+            if (isfinite(hi) && isfinite(lo)) {
+                s->hi = hi;
+                s->lo = lo;
+                continue;
+            }
+        }
+        for (size_t j = 0; j < m; ++j) neumaier_add(s, b[j]);
+    }
+}
+
+/* ---------- Counting ---------- */
+
+/* Largest value span counted with a direct histogram instead of a hash table. */
+#define HISTOGRAM_MAX_RANGE ((size_t)1 << 24)
+
+/*
+  Exact key -> count table (open addressing, linear probing).
+  A zero count marks an empty slot. Growth stops at 'max_entries' distinct
+  keys; count_table_add() then returns 0 and the caller falls back to the
+  quantile sketch.
+*/
+typedef struct {
+    int64_t *keys;
+    size_t *counts;
+    size_t cap;          /* power of two */
+    size_t size;
+    size_t max_entries;
+} count_table;
+
+/* Mixes the high bits down too: double keys differ mostly in their top bits. */
+static size_t count_slot(int64_t k, size_t cap) {
+    uint64_t h = (uint64_t)k;
+    h ^= h >> 33;
+    h *= 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 29;
+    return (size_t)h & (cap - 1);
+}
+
+static int count_table_init(count_table *t, size_t max_entries) {
+    t->cap = 1024;
+    t->size = 0;
+    t->max_entries = max_entries;
+    t->keys = (int64_t *)malloc(t->cap * sizeof(int64_t));
+    t->counts = (size_t *)calloc(t->cap, sizeof(size_t));
+    return t->keys && t->counts;
+}
+
+static void count_table_free(count_table *t) {
+    free(t->keys);
+    free(t->counts);
+    t->keys = NULL;
+    t->counts = NULL;
+    t->cap = t->size = 0;
+}
+
+static int count_table_grow(count_table *t) {
+    const size_t cap = t->cap * 2;
+    int64_t *keys = (int64_t *)malloc(cap * sizeof(int64_t));
+    size_t *counts = (size_t *)calloc(cap, sizeof(size_t));
+    if (!keys || !counts) { free(keys); free(counts); return 0; }
+    for (size_t i = 0; i < t->cap; ++i) {
+        if (!t->counts[i]) continue;
+        size_t j = count_slot(t->keys[i], cap);
+        while (counts[j]) j = (j + 1) & (cap - 1);
+        keys[j] = t->keys[i];
+        counts[j] = t->counts[i];
+    }
+    free(t->keys);
+    free(t->counts);
+    t->keys = keys;
+    t->counts = counts;
+    t->cap = cap;
+    return 1;
+}
+
+/* Returns 1 if counted, 0 if the key is new and the table is full (or out of memory). */
+static int count_table_add(count_table *t, int64_t k, size_t times) {
+    size_t j = count_slot(k, t->cap);
+    while (t->counts[j]) {
+        if (t->keys[j] == k) { t->counts[j] += times; return 1; }
+        j = (j + 1) & (t->cap - 1);
+    }
+    if (t->size >= t->max_entries) return 0;
+    if ((t->size + 1) * 10 > t->cap * 7) {
+        if (!count_table_grow(t)) return 0;
+        return count_table_add(t, k, times);
+    }
+    t->keys[j] = k;
+    t->counts[j] = times;
+    ++t->size;
+    return 1;
+}
+
+static size_t count_table_get(const count_table *t, int64_t k) {
+    size_t j = count_slot(k, t->cap);
+    while (t->counts[j]) {
+        if (t->keys[j] == k) return t->counts[j];
+        j = (j + 1) & (t->cap - 1);
+    }
+    return 0;
+}
+
+/*
+  Misra-Gries heavy hitters over a count table of 2 * HH_K slots. When the
+  table fills, the (HH_K+1)-th largest count is subtracted from every entry
+  and the non-positive ones dropped. Every kept count undercounts its value by
+  at most 'error' (<= n / (HH_K+1)), any value more frequent than that stays
+  in the table, and two tables merge by adding counts and pruning again.
+*/
+#define HH_K 1024
+
+typedef struct {
+    count_table table;
+    size_t error;        /* total subtracted from each surviving count */
+} heavy_hitters;
+
+static int hh_init(heavy_hitters *h) {
+    h->error = 0;
+    return count_table_init(&h->table, 2 * HH_K);
+}
+
+static void hh_free(heavy_hitters *h) {
+    count_table_free(&h->table);
+}
+
+static int cmp_size_desc(const void *a, const void *b) {
+    const size_t x = *(const size_t *)a, y = *(const size_t *)b;
+    return (x < y) - (x > y);
+}
+
+static int hh_prune(heavy_hitters *h) {
+    size_t *counts = (size_t *)malloc(h->table.size * sizeof(size_t));
+    if (!counts) return 0;
+    size_t k = 0;
+    for (size_t i = 0; i < h->table.cap; ++i) if (h->table.counts[i]) counts[k++] = h->table.counts[i];
+    qsort(counts, k, sizeof(size_t), cmp_size_desc);
+    const size_t cut = k > HH_K ? counts[HH_K] : 0;
+    free(counts);
+    if (cut == 0) return 1;
+
+    count_table kept;
+    if (!count_table_init(&kept, h->table.max_entries)) { count_table_free(&kept); return 0; }
+    for (size_t i = 0; i < h->table.cap; ++i) {
+        if (h->table.counts[i] > cut && !count_table_add(&kept, h->table.keys[i], h->table.counts[i] - cut)) {
+            count_table_free(&kept);
+            return 0;
+        }
+    }
+    count_table_free(&h->table);
+    h->table = kept;
+    h->error += cut;
+    return 1;
+}
+
+static int hh_add(heavy_hitters *h, int64_t k, size_t times) {
+    if (count_table_add(&h->table, k, times)) return 1;
+    if (h->table.size < h->table.max_entries || !hh_prune(h)) return 0;   // out of memory
+    return count_table_add(&h->table, k, times);
+}
+
+/*
+  Largest kept count (smallest key on ties); 0 if the table is empty.
+  *runner_up gets the next largest kept count (0 if there is none).
+*/
+static size_t hh_top(const heavy_hitters *h, int64_t *key, size_t *runner_up) {
+    size_t best = 0, second = 0;
+    for (size_t i = 0; i < h->table.cap; ++i) {
+        const size_t c = h->table.counts[i];
+        if (c > best || (c && c == best && h->table.keys[i] < *key)) {
+            second = best;
+            best = c;
+            *key = h->table.keys[i];
+        } else if (c > second) {
+            second = c;
+        }
+    }
+    *runner_up = second;
+    return best;
+}
+
+/*
+  The top value is certainly a mode when its true count (at least its kept
+  count) is no less than any other value's (at most the runner-up's kept
+  count plus 'error'; untracked values are at most 'error').
+*/
+static int hh_mode_certain(const heavy_hitters *h, size_t top, size_t runner_up) {
+    return top > 0 && top >= runner_up + h->error;
+}
+
+/*
+  KLL quantile sketch: a stack of compactors where an item at level h stands
+  for 2^h inputs. A full level is sorted and every other item (random offset)
+  is promoted, so memory stays O(k log(n/k)) with rank error about 1/k.
+*/
+#define KLL_K 400
+#define KLL_MAX_LEVELS 64
+
+typedef struct {
+    int64_t *items[KLL_MAX_LEVELS];
+    size_t size[KLL_MAX_LEVELS];
+    size_t cap[KLL_MAX_LEVELS];
+    size_t levels;
+    uint64_t rng;
+} kll_sketch;
+
+static void kll_init(kll_sketch *s) {
+    memset(s, 0, sizeof *s);
+    s->levels = 1;
+    s->rng = 0x2545F4914F6CDD1DULL;
+}
+
+static void kll_free(kll_sketch *s) {
+    for (size_t h = 0; h < KLL_MAX_LEVELS; ++h) free(s->items[h]);
+    memset(s, 0, sizeof *s);
+}
+
+/* Capacity of level h: k at the top, shrinking by 2/3 per level below, at least 2. */
+static size_t kll_capacity(const kll_sketch *s, size_t h) {
+    size_t c = KLL_K;
+    for (size_t d = h + 1; d < s->levels && c > 2; ++d) c = c * 2 / 3;
+    return c < 2 ? 2 : c;
+}
+
+static int kll_push(kll_sketch *s, size_t h, int64_t k) {
+    if (s->size[h] == s->cap[h]) {
+        const size_t cap = s->cap[h] ? s->cap[h] * 2 : 16;
+        int64_t *p = (int64_t *)realloc(s->items[h], cap * sizeof(int64_t));
+        if (!p) return 0;
+        s->items[h] = p;
+        s->cap[h] = cap;
+    }
+    s->items[h][s->size[h]++] = k;
+    return 1;
+}
+
+static int cmp_int64(const void *a, const void *b) {
+    const int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int kll_compress(kll_sketch *s) {
+    for (;;) {
+        size_t h = 0;
+        while (h < s->levels && s->size[h] < kll_capacity(s, h)) ++h;
+        if (h == s->levels) return 1;
+        if (h + 1 == s->levels) {
+            if (s->levels == KLL_MAX_LEVELS) return 0;
+            ++s->levels;
+        }
+        int64_t *it = s->items[h];
+        size_t n = s->size[h];
+        qsort(it, n, sizeof(int64_t), cmp_int64);
+        s->rng ^= s->rng << 13; s->rng ^= s->rng >> 7; s->rng ^= s->rng << 17;
+        const size_t offset = (size_t)(s->rng & 1);
+        const int keep_last = (int)(n & 1);
+        if (keep_last) --n;
+        for (size_t i = offset; i < n; i += 2) {
+            if (!kll_push(s, h + 1, it[i])) return 0;
+        }
+        if (keep_last) it[0] = it[n];
+        s->size[h] = (size_t)keep_last;
+    }
+}
+
+/* Adds 'times' copies of key k: one item per set bit, at the matching level. */
+static int kll_add(kll_sketch *s, int64_t k, size_t times) {
+    for (size_t h = 0; times; ++h, times >>= 1) {
+        if (!(times & 1)) continue;
+        while (h >= s->levels) {
+            if (s->levels == KLL_MAX_LEVELS) return 0;
+            ++s->levels;
+        }
+        if (!kll_push(s, h, k)) return 0;
+    }
+    return kll_compress(s);
+}
+
+typedef struct {
+    int64_t key;
+    uint64_t weight;
+} weighted_key;
+
+static int cmp_weighted(const void *a, const void *b) {
+    return cmp_int64(&((const weighted_key *)a)->key, &((const weighted_key *)b)->key);
+}
+
+/* Approximate middle pair (as median_sorted() reads it). 0 if empty or on allocation failure. */
+static int kll_middle(const kll_sketch *s, int64_t *left_out, int64_t *right_out) {
+    size_t total = 0;
+    for (size_t h = 0; h < s->levels; ++h) total += s->size[h];
+    weighted_key *all = (weighted_key *)malloc((total ? total : 1) * sizeof(weighted_key));
+    if (!all || total == 0) { free(all); return 0; }
+    size_t k = 0;
+    uint64_t weight = 0;
+    for (size_t h = 0; h < s->levels; ++h) {
+        for (size_t i = 0; i < s->size[h]; ++i) {
+            all[k].key = s->items[h][i];
+            all[k].weight = (uint64_t)1 << h;
+            weight += all[k].weight;
+            ++k;
+        }
+    }
+    qsort(all, k, sizeof(weighted_key), cmp_weighted);
+    const uint64_t lo = (weight - 1) / 2, hi = weight / 2;
+    uint64_t seen = 0;
+    *left_out = all[0].key;
+    *right_out = all[k - 1].key;
+    for (size_t i = 0; i < k; ++i) {
+        const uint64_t next = seen + all[i].weight;
+        if (lo >= seen && lo < next) *left_out = all[i].key;
+        if (hi >= seen && hi < next) { *right_out = all[i].key; break; }
+        seen = next;
+    }
+    free(all);
+    return 1;
+}
+
+/* ---------- Streaming state ---------- */
+
+/*
+  One-pass state: count, sum, min/max, and either the exact count table or
+  (once it overflows) the KLL sketch plus heavy hitters. Memory is bounded
+  by the table budget plus the sketches. Partial states combine with
+  stream_merge(), also after a round trip through the summary encoding.
+*/
+typedef struct {
+    value_type type;
+    size_t n;
+    stats_sum sum;
+    int64_t min, max;    /* keys; valid when n > 0 */
+    count_table table;
+    kll_sketch sketch;
+    heavy_hitters hh;
+    int approximate;     /* table overflowed: median from the sketch, mode from hh */
+    size_t distinct_limit;   /* when approximate: more than this many distinct values (0: unknown) */
+} stream_stats;
+
+static int stream_init(stream_stats *st, size_t max_distinct, value_type type) {
+    memset(st, 0, sizeof *st);
+    st->type = type;
+    kll_init(&st->sketch);
+    return count_table_init(&st->table, max_distinct);
+}
+
+static void stream_free(stream_stats *st) {
+    count_table_free(&st->table);
+    kll_free(&st->sketch);
+    hh_free(&st->hh);
+}
+
+/* Moves every counted value into the sketches and drops the table. */
+static int stream_go_approximate(stream_stats *st) {
+    if (!hh_init(&st->hh)) return 0;
+    for (size_t i = 0; i < st->table.cap; ++i) {
+        const size_t c = st->table.counts[i];
+        if (!c) continue;
+        if (!kll_add(&st->sketch, st->table.keys[i], c) || !hh_add(&st->hh, st->table.keys[i], c)) return 0;
+    }
+    count_table_free(&st->table);
+    st->approximate = 1;
+    return 1;
+}
+
+static int stream_count(stream_stats *st, int64_t k, size_t times) {
+    if (!st->approximate) {
+        if (count_table_add(&st->table, k, times)) return 1;
+        if (st->table.max_entries > st->distinct_limit) st->distinct_limit = st->table.max_entries;
+        if (!stream_go_approximate(st)) return 0;
+    }
+    return kll_add(&st->sketch, k, times) && hh_add(&st->hh, k, times);
+}
+
+static void stream_extend_range(stream_stats *st, size_t n, int64_t min, int64_t max) {
+    if (st->n == 0 || min < st->min) st->min = min;
+    if (st->n == 0 || max > st->max) st->max = max;
+    st->n += n;
+}
+
+#define STREAM_CHUNK (1u << 20)
+#define MAX_TOKEN 64
+#define STREAM_BATCH 4096
+
+static int is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+/* strtod needs a terminated copy; tokens are at most MAX_TOKEN bytes. */
+static int parse_double_token(const char *tok, size_t len, double *out) {
+    char buf[MAX_TOKEN + 1];
+    memcpy(buf, tok, len);
+    buf[len] = '\0';
+    return parse_double_strict(buf, out);
+}
+
+/* ---------- Kernels ---------- */
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+/* Binary records are little-endian; only big-endian hosts copy them out. */
+static int load_i32(const char *p) {
+    uint32_t w;
+    memcpy(&w, p, sizeof w);
+    return (int)__builtin_bswap32(w);
+}
+static int64_t load_i64(const char *p) { return (int64_t)load_le64(p); }
+static double load_f64(const char *p) {
+    const uint64_t u = load_le64(p);
+    double v;
+    memcpy(&v, &u, sizeof v);
+    return v;
+}
+#endif
+
+#define STATS_T int
+#define STATS_NAME(x) x##_i32
+#define STATS_TYPE TYPE_I32
+#define STATS_INTEGRAL 1
+#define STATS_UKEY uint32_t
+#define STATS_RADIX_KEY(v) ((uint32_t)(v) ^ 0x80000000u)
+#define STATS_KEY(v) ((int64_t)(v))
+#define STATS_FROM_KEY(k) ((int)(k))
+#define STATS_MIDPOINT(a, b) (((double)(a) + (double)(b)) / 2.0)
+#define STATS_PARSE_ARG(s, out) parse_int_strict(s, out)
+#define STATS_PARSE_TOKEN(s, len, out) parse_int_fast(s, len, out)
+#define STATS_VALID(v) 1
+#define STATS_LOAD(p) load_i32(p)
+#define STATS_PRINT(v) printf("%d", v)
+#include "stats_kernels.h"
+
+#define STATS_T int64_t
+#define STATS_NAME(x) x##_i64
+#define STATS_TYPE TYPE_I64
+#define STATS_INTEGRAL 1
+#define STATS_UKEY uint64_t
+#define STATS_RADIX_KEY(v) ((uint64_t)(v) ^ 0x8000000000000000ull)
+#define STATS_KEY(v) (v)
+#define STATS_FROM_KEY(k) (k)
+#define STATS_MIDPOINT(a, b) key_midpoint(TYPE_I64, a, b)
+#define STATS_PARSE_ARG(s, out) parse_int64_strict(s, out)
+#define STATS_PARSE_TOKEN(s, len, out) parse_int64_fast(s, len, out)
+#define STATS_VALID(v) 1
+#define STATS_LOAD(p) load_i64(p)
+#define STATS_PRINT(v) printf("%lld", (long long)(v))
+#include "stats_kernels.h"
+
+#define STATS_T double
+#define STATS_NAME(x) x##_f64
+#define STATS_TYPE TYPE_F64
+#define STATS_INTEGRAL 0
+#define STATS_UKEY uint64_t
+#define STATS_RADIX_KEY(v) ((uint64_t)key_f64(v) ^ 0x8000000000000000ull)
+#define STATS_KEY(v) key_f64(v)
+#define STATS_FROM_KEY(k) from_key_f64(k)
+#define STATS_MIDPOINT(a, b) midpoint_f64(a, b)
+#define STATS_PARSE_ARG(s, out) parse_double_strict(s, out)
+#define STATS_PARSE_TOKEN(s, len, out) parse_double_token(s, len, out)
+#define STATS_VALID(v) isfinite(v)
+#define STATS_LOAD(p) load_f64(p)
+#define STATS_PRINT(v) print_double(v)
+#include "stats_kernels.h"
+
+/* ---------- Streaming summaries ---------- */
+
+typedef struct {
+    int64_t key;
+    size_t count;
+} value_count;
+
+/* The table's entries sorted by key (radix sort); caller frees. NULL on allocation failure. */
+static value_count *count_table_sorted(const count_table *t) {
+    const size_t n = t->size ? t->size : 1;
+    value_count *out = (value_count *)malloc(n * sizeof(value_count));
+    int64_t *keys = (int64_t *)malloc(n * sizeof(int64_t));
+    int64_t *tmp = (int64_t *)malloc(n * sizeof(int64_t));
+    if (!out || !keys || !tmp) { free(out); free(keys); free(tmp); return NULL; }
+    size_t k = 0;
+    for (size_t i = 0; i < t->cap; ++i) if (t->counts[i]) keys[k++] = t->keys[i];
+    radix_sort_i64(keys, tmp, k);
+    for (size_t i = 0; i < k; ++i) { out[i].key = keys[i]; out[i].count = count_table_get(t, keys[i]); }
+    free(keys);
+    free(tmp);
+    return out;
+}
+
+/* Middle pair of the expanded multiset, as median_sorted() reads it. */
+static void median_counts(const value_count *vc, size_t distinct, size_t n,
+                          int64_t *left_out, int64_t *right_out) {
+    const size_t lo = (n - 1) / 2, hi = n / 2;   /* 0-based ranks of the middle pair */
+    size_t seen = 0;
+    *left_out = *right_out = vc[0].key;
+    for (size_t i = 0; i < distinct; ++i) {
+        const size_t next = seen + vc[i].count;
+        if (lo >= seen && lo < next) *left_out = vc[i].key;
+        if (hi >= seen && hi < next) { *right_out = vc[i].key; return; }
+        seen = next;
+    }
+}
+
+/* Pushes sketch items level by level; the caller compresses. */
+static int kll_absorb(kll_sketch *dst, size_t level, const int64_t *items, size_t k) {
+    while (level >= dst->levels) {
+        if (dst->levels == KLL_MAX_LEVELS) return 0;
+        ++dst->levels;
+    }
+    for (size_t i = 0; i < k; ++i) {
+        if (!kll_push(dst, level, items[i])) return 0;
+    }
+    return 1;
+}
+
+/* Folds 'src' into 'dst' (same type). Exact parts merge exactly; sketches merge level by level. */
+static int stream_merge(stream_stats *dst, const stream_stats *src) {
+    if (src->n == 0) return 1;
+    stream_extend_range(dst, src->n, src->min, src->max);
+    stats_sum_merge(&dst->sum, &src->sum);
+    if (!src->approximate) {
+        for (size_t i = 0; i < src->table.cap; ++i) {
+            if (src->table.counts[i] && !stream_count(dst, src->table.keys[i], src->table.counts[i])) return 0;
+        }
+        return 1;
+    }
+    if (!dst->approximate && !stream_go_approximate(dst)) return 0;
+    if (src->distinct_limit > dst->distinct_limit) dst->distinct_limit = src->distinct_limit;
+    for (size_t h = 0; h < src->sketch.levels; ++h) {
+        if (!kll_absorb(&dst->sketch, h, src->sketch.items[h], src->sketch.size[h])) return 0;
+    }
+    for (size_t i = 0; i < src->hh.table.cap; ++i) {
+        if (src->hh.table.counts[i] && !hh_add(&dst->hh, src->hh.table.keys[i], src->hh.table.counts[i])) return 0;
+    }
+    dst->hh.error += src->hh.error;
+    return kll_compress(&dst->sketch);
+}
+
+/* ---------- Summary encoding ---------- */
+
+/*
+  Compact, portable encoding of a stream_stats, so per-shard summaries can be
+  shipped and merged hierarchically instead of raw samples. Layout:
+
+    "STATSUM1"  varint flags (bit 0: approximate, bits 1-2: value type,
+                bit 3: a sum scale follows the sum,
+                bit 4: a distinct-value limit follows hh_error)  varint n
+    sum: 16 bytes little-endian (integers: 128-bit two's complement;
+         doubles: the Neumaier pair hi, lo as IEEE bits)
+    [zigzag sum scale, doubles only: the pair is (hi + lo) * 2^scale]
+    zigzag min key  zigzag max key
+    exact:        varint m, then m x (zigzag key delta, varint count)
+    approximate:  varint hh_error, [varint distinct limit: the shard saw more
+                  distinct values than this], varint m, m x (zigzag key delta, varint count),
+                  varint levels, per level: varint size, size x zigzag key delta
+
+  Entries and sketch levels are written in key order, so keys are
+  delta-coded (mod 2^64). A decoded summary is folded straight into a
+  stream_stats of the same type.
+*/
+static const char SUMMARY_MAGIC[8] = {'S', 'T', 'A', 'T', 'S', 'U', 'M', '1'};
+
+typedef struct {
+    unsigned char *p;
+    size_t len, cap;
+} summary_buf;
+
+static int sb_put(summary_buf *b, const void *src, size_t k) {
+    if (b->len + k > b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 4096;
+        while (cap < b->len + k) cap *= 2;
+        unsigned char *p = (unsigned char *)realloc(b->p, cap);
+        if (!p) return 0;
+        b->p = p;
+        b->cap = cap;
+    }
+    memcpy(b->p + b->len, src, k);
+    b->len += k;
+    return 1;
+}
+
+static int sb_varint(summary_buf *b, uint64_t v) {
+    unsigned char out[10];
+    size_t k = 0;
+    do {
+        out[k] = (unsigned char)(v & 0x7F);
+        v >>= 7;
+        if (v) out[k] |= 0x80;
+        ++k;
+    } while (v);
+    return sb_put(b, out, k);
+}
+
+static uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+static int64_t unzigzag(uint64_t u) { return (int64_t)(u >> 1) ^ -(int64_t)(u & 1); }
+
+static uint64_t key_delta(int64_t k, int64_t prev) { return zigzag((int64_t)((uint64_t)k - (uint64_t)prev)); }
+
+static void sum_to_words(value_type t, const stats_sum *s, uint64_t *w0, uint64_t *w1) {
+    if (t == TYPE_F64) {
+        memcpy(w0, &s->hi, sizeof *w0);
+        memcpy(w1, &s->lo, sizeof *w1);
+        return;
+    }
+#ifdef __SIZEOF_INT128__
+    *w0 = (uint64_t)s->exact;
+    *w1 = (uint64_t)(int64_t)(s->exact >> 64);
+#else
+    const long double two64 = 18446744073709551616.0L;
+    const long double h = floorl(s->exact / two64);
+    *w1 = (uint64_t)(int64_t)h;
+    *w0 = (uint64_t)(s->exact - h * two64);
+#endif
+}
+
+static void words_to_sum(value_type t, uint64_t w0, uint64_t w1, stats_sum *s) {
+    const stats_sum zero = STATS_SUM_ZERO;
+    *s = zero;
+    if (t == TYPE_F64) {
+        memcpy(&s->hi, &w0, sizeof w0);
+        memcpy(&s->lo, &w1, sizeof w1);
+        return;
+    }
+#ifdef __SIZEOF_INT128__
+    s->exact = (wide_sum)(int64_t)w1 * ((wide_sum)1 << 64) + (wide_sum)w0;
+#else
+    s->exact = (long double)(int64_t)w1 * 18446744073709551616.0L + (long double)w0;
+#endif
+}
+
+/* Key-sorted (key, count) pairs: the shared body of both table sections. */
+static int sb_table(summary_buf *b, const count_table *t) {
+    value_count *vc = count_table_sorted(t);
+    if (!vc) return 0;
+    int ok = sb_varint(b, t->size);
+    int64_t prev = 0;
+    for (size_t i = 0; ok && i < t->size; ++i) {
+        ok = sb_varint(b, key_delta(vc[i].key, prev)) && sb_varint(b, vc[i].count);
+        prev = vc[i].key;
+    }
+    free(vc);
+    return ok;
+}
 
-        if ((int)count > maxf) {
-            maxf = (int)count;
-            modes_out[0] = value;
-            modes_count = 1;
-        } else if ((int)count == maxf) {
-            modes_out[modes_count++] = value;
+/* Sorts each sketch level in place (order within a level is free) and writes it. */
+static int sb_sketch(summary_buf *b, kll_sketch *s) {
+    if (!sb_varint(b, s->levels)) return 0;
+    for (size_t h = 0; h < s->levels; ++h) {
+        qsort(s->items[h], s->size[h], sizeof(int64_t), cmp_int64);
+        if (!sb_varint(b, s->size[h])) return 0;
+        int64_t prev = 0;
+        for (size_t i = 0; i < s->size[h]; ++i) {
+            if (!sb_varint(b, key_delta(s->items[h][i], prev))) return 0;
+            prev = s->items[h][i];
         }
+    }
+    return 1;
+}
 
-        i += count;
+/* Appends the encoding of 'st' to 'b'. 0 on allocation failure. */
+static int summary_encode(stream_stats *st, summary_buf *b) {
+    uint64_t w0, w1;
+    sum_to_words(st->type, &st->sum, &w0, &w1);
+    unsigned char sum[16];
+    for (int i = 0; i < 8; ++i) {
+        sum[i] = (unsigned char)(w0 >> (8 * i));
+        sum[8 + i] = (unsigned char)(w1 >> (8 * i));
+    }
+    const int scaled = st->type == TYPE_F64 && st->sum.scale != 0;
+    const int limited = st->approximate && st->distinct_limit != 0;
+    const uint64_t flags = (uint64_t)st->approximate | (uint64_t)st->type << 1 | (uint64_t)scaled << 3 |
+                           (uint64_t)limited << 4;
+    if (!sb_put(b, SUMMARY_MAGIC, sizeof SUMMARY_MAGIC) || !sb_varint(b, flags) ||
+        !sb_varint(b, st->n) || !sb_put(b, sum, sizeof sum) ||
+        (scaled && !sb_varint(b, zigzag(st->sum.scale))) ||
+        !sb_varint(b, zigzag(st->n ? st->min : 0)) || !sb_varint(b, zigzag(st->n ? st->max : 0))) {
+        return 0;
     }
+    if (!st->approximate) return sb_table(b, &st->table);
+    return sb_varint(b, st->hh.error) && (!limited || sb_varint(b, st->distinct_limit)) &&
+           sb_table(b, &st->hh.table) && sb_sketch(b, &st->sketch);
+}
 
-    *maxfreq_out = maxf;
-    return modes_count;
+typedef struct {
+    const unsigned char *p, *end;
+    value_type type;
+    int ok;
+} summary_reader;
+
+static uint64_t sr_varint(summary_reader *r) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (r->p == r->end) break;
+        const unsigned char c = *r->p++;
+        v |= (uint64_t)(c & 0x7F) << shift;
+        if (!(c & 0x80)) return v;
+    }
+    r->ok = 0;
+    return 0;
+}
+
+/* Next delta-coded key; fails the reader if it is not a valid key of the summary's type. */
+static int64_t sr_key(summary_reader *r, int64_t *prev) {
+    const int64_t k = (int64_t)((uint64_t)*prev + (uint64_t)unzigzag(sr_varint(r)));
+    if (!key_valid(r->type, k)) r->ok = 0;
+    *prev = k;
+    return k;
+}
+
+/* Entries can be no shorter than 'min_bytes' each; rejects counts the input cannot hold. */
+static size_t sr_count(summary_reader *r, size_t min_bytes) {
+    const uint64_t m = sr_varint(r);
+    if (m > (uint64_t)(r->end - r->p) / min_bytes) r->ok = 0;
+    return r->ok ? (size_t)m : 0;
+}
+
+enum { SUMMARY_OK, SUMMARY_CORRUPT, SUMMARY_TYPE_MISMATCH, SUMMARY_NO_MEMORY };
+
+/*
+  Decodes one summary from [p, p + len) and folds it into 'dst'. A state
+  that has seen no values takes the summary's type; otherwise the types
+  must match. Returns SUMMARY_OK or the reason it failed.
+*/
+static int summary_merge(stream_stats *dst, const unsigned char *p, size_t len) {
+    summary_reader r = {p, p + len, TYPE_I32, 1};
+    if (len < sizeof SUMMARY_MAGIC + 16 || memcmp(p, SUMMARY_MAGIC, sizeof SUMMARY_MAGIC) != 0) return SUMMARY_CORRUPT;
+    r.p += sizeof SUMMARY_MAGIC;
+    const uint64_t flags = sr_varint(&r);
+    const uint64_t n = sr_varint(&r);
+    if (!r.ok || (flags & 7) > 5 || flags >> 5 || (size_t)(r.end - r.p) < 16) return SUMMARY_CORRUPT;
+    if ((flags & 16) && !(flags & 1)) return SUMMARY_CORRUPT;
+    r.type = (value_type)((flags >> 1) & 3);
+    if ((flags & 8) && r.type != TYPE_F64) return SUMMARY_CORRUPT;
+    uint64_t w0 = 0, w1 = 0;
+    for (int i = 0; i < 8; ++i) {
+        w0 |= (uint64_t)r.p[i] << (8 * i);
+        w1 |= (uint64_t)r.p[8 + i] << (8 * i);
+    }
+    r.p += 16;
+    const int64_t scale = (flags & 8) ? unzigzag(sr_varint(&r)) : 0;
+    if (scale < 0 || scale > 1024 || scale % SUM_RESCALE_STEP) return SUMMARY_CORRUPT;
+    const int64_t min = unzigzag(sr_varint(&r)), max = unzigzag(sr_varint(&r));
+    if (!r.ok || (n && (!key_valid(r.type, min) || !key_valid(r.type, max) || min > max))) return SUMMARY_CORRUPT;
+
+    stream_stats src;
+    memset(&src, 0, sizeof src);
+    kll_init(&src.sketch);
+    src.type = r.type;
+    src.n = (size_t)n;
+    words_to_sum(r.type, w0, w1, &src.sum);
+    src.sum.scale = (int)scale;
+    src.min = min;
+    src.max = max;
+    src.approximate = (int)(flags & 1);
+    int ok = 1;
+    uint64_t weight = 0;
+    count_table *table = &src.table;
+    if (src.approximate) {
+        src.hh.error = (size_t)sr_varint(&r);
+        if (flags & 16) src.distinct_limit = (size_t)sr_varint(&r);
+        table = &src.hh.table;
+    }
+    const size_t m = sr_count(&r, 2);
+    ok = r.ok && count_table_init(table, SIZE_MAX);
+    int64_t prev = 0;
+    for (size_t i = 0; ok && i < m; ++i) {
+        const int64_t k = sr_key(&r, &prev);
+        const uint64_t c = sr_varint(&r);
+        if (c == 0 || count_table_get(table, k) != 0) r.ok = 0;   // entries are distinct and non-empty
+        ok = r.ok && count_table_add(table, k, (size_t)c);
+        weight += c;
+    }
+    if (ok && src.approximate) {
+        src.hh.table.max_entries = 2 * HH_K;
+        src.sketch.levels = (size_t)sr_varint(&r);
+        if (src.sketch.levels == 0 || src.sketch.levels > KLL_MAX_LEVELS || m > 2 * HH_K) r.ok = 0;
+        weight = 0;
+        for (size_t h = 0; r.ok && ok && h < src.sketch.levels; ++h) {
+            const size_t k = sr_count(&r, 1);
+            prev = 0;
+            for (size_t i = 0; r.ok && ok && i < k; ++i) {
+                ok = kll_push(&src.sketch, h, sr_key(&r, &prev));
+                weight += (uint64_t)1 << h;
+            }
+        }
+        ok = ok && r.ok;
+    }
+    // A summary must account for exactly n values and nothing may follow it.
+    const int valid = r.ok && r.p == r.end && weight == n;
+    int rc = !ok && r.ok ? SUMMARY_NO_MEMORY : !valid ? SUMMARY_CORRUPT : SUMMARY_OK;
+    if (rc == SUMMARY_OK && src.n) {
+        if (dst->n == 0) dst->type = src.type;
+        else if (src.type != dst->type) rc = SUMMARY_TYPE_MISMATCH;
+    }
+    if (rc == SUMMARY_OK && !stream_merge(dst, &src)) rc = SUMMARY_NO_MEMORY;
+    stream_free(&src);
+    return rc;
+}
+
+/* ---------- Streaming input ---------- */
+
+static void report_token(value_type t, const char *tok, size_t len) {
+    if (len > MAX_TOKEN) len = MAX_TOKEN;   /* too long to be a value; shown truncated */
+    fprintf(stderr, "Invalid %s: '%.*s'\n", value_type_noun(t), (int)len, tok);
+}
+
+static int stream_parse(stream_stats *st, const char *p, const char *end,
+                        const char **bad, size_t *bad_len) {
+    switch (st->type) {
+    case TYPE_I64: return stream_parse_i64(st, p, end, bad, bad_len);
+    case TYPE_F64: return stream_parse_f64(st, p, end, bad, bad_len);
+    default: return stream_parse_i32(st, p, end, bad, bad_len);
+    }
+}
+
+static int stream_binary(stream_stats *st, const char *p, const char *end, const char **bad) {
+    switch (st->type) {
+    case TYPE_I64: return stream_binary_i64(st, p, end, bad);
+    case TYPE_F64: return stream_binary_f64(st, p, end, bad);
+    default: return stream_binary_i32(st, p, end, bad);
+    }
+}
+
+/*
+  Reads whitespace-separated values from 'in' in STREAM_CHUNK blocks.
+  A token cut by a block boundary is carried into the next block.
+*/
+static int stream_read(FILE *in, stream_stats *st) {
+    char *buf = (char *)malloc(STREAM_CHUNK + MAX_TOKEN + 1);
+    if (!buf) { perror("malloc"); return 0; }
+    size_t carry = 0;
+    int ok = 1;
+    for (;;) {
+        const size_t got = fread(buf + carry, 1, STREAM_CHUNK, in);
+        const size_t len = carry + got;
+        const int eof = got == 0;
+        /* Hold back a trailing partial token unless this is the last block. */
+        size_t cut = len;
+        if (!eof) while (cut > 0 && !is_space(buf[cut - 1])) --cut;
+        const char *bad;
+        size_t bad_len;
+        if (!stream_parse(st, buf, buf + cut, &bad, &bad_len)) {
+            if (bad) report_token(st->type, bad, bad_len);
+            else fprintf(stderr, "Out of memory\n");
+            ok = 0;
+            break;
+        }
+        carry = len - cut;
+        if (carry > MAX_TOKEN) {            /* a token this long cannot be valid */
+            report_token(st->type, buf + cut, carry);
+            ok = 0;
+            break;
+        }
+        memmove(buf, buf + cut, carry);
+        if (eof) break;
+    }
+    if (ok && ferror(in)) { perror("read"); ok = 0; }
+    free(buf);
+    return ok;
+}
+
+/* Read-only private mapping of 'path'; an empty file maps to "" with *size = 0. */
+static const char *map_file(const char *path, size_t *size) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) { perror(path); return NULL; }
+    struct stat sb;
+    if (fstat(fd, &sb) != 0) { perror(path); close(fd); return NULL; }
+    *size = (size_t)sb.st_size;
+    const char *data = "";
+    if (*size > 0) {
+        void *p = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) { perror(path); close(fd); return NULL; }
+        data = (const char *)p;
+    }
+    close(fd);
+    return data;
+}
+
+static void unmap_file(const char *data, size_t size) {
+    if (size > 0) munmap((void *)data, size);
+}
+
+/* ---------- Parallel streaming ---------- */
+
+typedef struct {
+    const char *begin, *end;
+    int binary;          /* raw records of the state's type instead of text */
+    stream_stats st;
+    int ok;
+    const char *bad;
+    size_t bad_len;
+} stream_part;
+
+static void *stream_part_run(void *arg) {
+    stream_part *part = (stream_part *)arg;
+    if (part->binary) {
+        part->ok = stream_binary(&part->st, part->begin, part->end, &part->bad);
+    } else {
+        part->ok = stream_parse(&part->st, part->begin, part->end, &part->bad, &part->bad_len);
+    }
+    return NULL;
+}
+
+/* Only f64 records can be rejected (nan or inf). */
+static void report_binary(const char *data, const char *bad) {
+    fprintf(stderr, "Non-finite value at byte offset %zu\n", (size_t)(bad - data));
+}
+
+/*
+  Maps 'path' and reduces it with 'threads' workers, one contiguous range each
+  (range edges moved to whitespace for text, to a record boundary for binary).
+  Partials are merged in file order, so exact results are identical to the
+  sequential reader, and the reported bad value is the first one in the file.
+*/
+static int stream_mapped(const char *path, int binary, unsigned threads, size_t max_distinct, stream_stats *out) {
+    size_t size;
+    const char *data = map_file(path, &size);
+    if (!data) return 0;
+    const size_t width = binary ? value_type_size(out->type) : 0;
+    if (width && size % width != 0) {
+        fprintf(stderr, "%s: size %zu is not a multiple of %zu-byte records\n", path, size, width);
+        unmap_file(data, size);
+        return 0;
+    }
+
+    stream_part *parts = (stream_part *)calloc(threads, sizeof(stream_part));
+    pthread_t *tids = (pthread_t *)calloc(threads, sizeof(pthread_t));
+    int ok = parts && tids;
+    size_t edge = 0;
+    unsigned started = 0;
+    for (unsigned t = 0; ok && t < threads; ++t) {
+        size_t stop = t + 1 == threads ? size : size / threads * (t + 1);
+        if (stop < edge) stop = edge;
+        if (width) stop -= stop % width;
+        else while (stop < size && !is_space(data[stop])) ++stop;
+        parts[t].begin = data + edge;
+        parts[t].end = data + stop;
+        parts[t].binary = binary;
+        edge = stop;
+        if (!stream_init(&parts[t].st, max_distinct, out->type)) { ok = 0; break; }
+        if (pthread_create(&tids[t], NULL, stream_part_run, &parts[t]) != 0) {
+            stream_free(&parts[t].st);
+            ok = 0;
+            break;
+        }
+        ++started;
+    }
+    for (unsigned t = 0; t < started; ++t) pthread_join(tids[t], NULL);
+
+    int reported = 0;
+    for (unsigned t = 0; t < started; ++t) {
+        if (ok && !parts[t].ok) {
+            if (!parts[t].bad) fprintf(stderr, "Out of memory\n");
+            else if (binary) report_binary(data, parts[t].bad);
+            else report_token(out->type, parts[t].bad, parts[t].bad_len);
+            ok = 0;
+            reported = 1;
+        }
+        if (ok && !stream_merge(out, &parts[t].st)) ok = 0;
+        stream_free(&parts[t].st);
+    }
+    if (!ok && !reported) fprintf(stderr, "Out of memory\n");
+    free(parts);
+    free(tids);
+    unmap_file(data, size);
+    return ok;
+}
+
+/* Count / Mean / Median / Mode for a non-empty state, as the argv path prints them. */
+static int print_stream(const stream_stats *st) {
+    printf("Count : %zu\n", st->n);
+    printf("Mean  : %.6f\n", stats_sum_mean(&st->sum, st->n));
+    int64_t left, right;
+    if (st->approximate) {
+        const double med = kll_middle(&st->sketch, &left, &right) ? key_midpoint(st->type, left, right) : NAN;
+        char many[64] = "too many distinct values";
+        if (st->distinct_limit) snprintf(many, sizeof many, "> %zu distinct values", st->distinct_limit);
+        printf("Median: %.6f (approximate, %s)\n", med, many);
+        int64_t top = 0;
+        size_t runner_up;
+        const size_t freq = hh_top(&st->hh, &top, &runner_up);
+        if (!hh_mode_certain(&st->hh, freq, runner_up)) {
+            printf("Mode  : n/a (%s; raise --max-distinct for an exact mode)\n", many);
+        } else {
+            printf("Mode  : ");
+            print_key(st->type, top);
+            printf(" (approximate, frequency %zu..%zu)\n", freq, freq + st->hh.error);
+        }
+        return 1;
+    }
+    value_count *vc = count_table_sorted(&st->table);
+    if (!vc) { perror("malloc"); return 0; }
+    const size_t distinct = st->table.size;
+    median_counts(vc, distinct, st->n, &left, &right);
+    printf("Median: %.6f\n", key_midpoint(st->type, left, right));
+    size_t maxfreq = 0;
+    for (size_t i = 0; i < distinct; ++i) if (vc[i].count > maxfreq) maxfreq = vc[i].count;
+    printf("Mode  : ");
+    int first = 1;
+    for (size_t i = 0; i < distinct; ++i) {
+        if (vc[i].count != maxfreq) continue;
+        if (!first) putchar(' ');
+        print_key(st->type, vc[i].key);
+        first = 0;
+    }
+    printf(" (frequency=%zu)\n", maxfreq);
+    free(vc);
+    return 1;
+}
+
+static int save_summary(stream_stats *st, const char *path) {
+    summary_buf b = {NULL, 0, 0};
+    if (!summary_encode(st, &b)) { perror("malloc"); free(b.p); return 0; }
+    FILE *out = fopen(path, "wb");
+    int ok = out && fwrite(b.p, 1, b.len, out) == b.len;
+    if (out && fclose(out) != 0) ok = 0;
+    if (!ok) perror(path);
+    free(b.p);
+    return ok;
+}
+
+/* Prints the state (or reports empty input) and optionally writes its summary. */
+static int finish_stream(stream_stats *st, const char *summary_path) {
+    int ok = 1;
+    if (summary_path) ok = save_summary(st, summary_path);
+    if (ok && st->n == 0) {
+        fprintf(stderr, "No input values\n");
+        ok = 0;
+    }
+    if (ok) ok = print_stream(st);
+    stream_free(st);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Binary input (raw records of 'type') needs a FILE, since it is mapped. */
+STATS_MAIN_ONLY static int run_stream(const char *path, value_type type, int binary, size_t max_distinct,
+                                      unsigned threads, const char *summary_path) {
+    stream_stats st;
+    if (!stream_init(&st, max_distinct, type)) { perror("malloc"); return EXIT_FAILURE; }
+    int ok;
+    if (path && strcmp(path, "-") != 0 && (threads > 1 || binary)) {
+        ok = stream_mapped(path, binary, threads, max_distinct, &st);
+    } else {
+        FILE *in = stdin;
+        if (path && strcmp(path, "-") != 0) {
+            in = fopen(path, "rb");
+            if (!in) { perror(path); stream_free(&st); return EXIT_FAILURE; }
+        }
+        ok = stream_read(in, &st);
+        if (in != stdin) fclose(in);
+    }
+    if (!ok) { stream_free(&st); return EXIT_FAILURE; }
+    return finish_stream(&st, summary_path);
+}
+
+/* Folds the summaries in paths[0..count) together, in order. */
+STATS_MAIN_ONLY static int run_merge(char **paths, int count, size_t max_distinct, const char *summary_path) {
+    stream_stats st;
+    if (!stream_init(&st, max_distinct, TYPE_I32)) { perror("malloc"); return EXIT_FAILURE; }
+    for (int i = 0; i < count; ++i) {
+        size_t size;
+        const char *data = map_file(paths[i], &size);
+        if (!data) { stream_free(&st); return EXIT_FAILURE; }
+        const int rc = summary_merge(&st, (const unsigned char *)data, size);
+        unmap_file(data, size);
+        if (rc != SUMMARY_OK) {
+            if (rc == SUMMARY_CORRUPT) fprintf(stderr, "%s: not a valid summary\n", paths[i]);
+            else if (rc == SUMMARY_TYPE_MISMATCH) fprintf(stderr, "%s: value type differs from earlier summaries\n", paths[i]);
+            else fprintf(stderr, "Out of memory\n");
+            stream_free(&st);
+            return EXIT_FAILURE;
+        }
+    }
+    return finish_stream(&st, summary_path);
 }
 
 /* ---------- Main ---------- */
 
+STATS_MAIN_ONLY static int parse_type(const char *s, value_type *out) {
+    if (strcmp(s, "i32") == 0) *out = TYPE_I32;
+    else if (strcmp(s, "i64") == 0) *out = TYPE_I64;
+    else if (strcmp(s, "f64") == 0) *out = TYPE_F64;
+    else return 0;
+    return 1;
+}
+
+#ifndef STATS_NO_MAIN
 int main(int argc, char **argv) {
     if (argc <= 1) {
         die_usage(argv[0]);
     }
 
-    const size_t n = (size_t)(argc - 1);
-    int *a = (int *)malloc(n * sizeof(int));
-    if (!a) {
-        perror("malloc");
-        return EXIT_FAILURE;
+    // Streaming mode: whitespace-separated values (or raw binary) from a file or stdin.
+    if (strcmp(argv[1], "--stream") == 0) {
+        const char *path = NULL;
+        size_t max_distinct = (size_t)1 << 24;
+        unsigned threads = 1;
+        value_type type = TYPE_I32, format_type = TYPE_I32;
+        int type_set = 0, binary = 0;
+        const char *summary_path = NULL;
+        for (int i = 2; i < argc; ++i) {
+            if (strcmp(argv[i], "--max-distinct") == 0 && i + 1 < argc) {
+                char *end = NULL;
+                max_distinct = (size_t)strtoull(argv[++i], &end, 10);
+                if (*end != '\0' || max_distinct == 0) die_usage(argv[0]);
+            } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+                char *end = NULL;
+                const unsigned long t = strtoul(argv[++i], &end, 10);
+                if (*end != '\0' || t == 0 || t > 1024) die_usage(argv[0]);
+                threads = (unsigned)t;
+            } else if (strcmp(argv[i], "--type") == 0 && i + 1 < argc) {
+                if (!parse_type(argv[++i], &type)) die_usage(argv[0]);
+                type_set = 1;
+            } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+                const char *f = argv[++i];
+                binary = strcmp(f, "text") != 0;
+                if (binary && !parse_type(f, &format_type)) die_usage(argv[0]);
+            } else if (strcmp(argv[i], "--save-summary") == 0 && i + 1 < argc) {
+                summary_path = argv[++i];
+            } else if (!path) {
+                path = argv[i];
+            } else {
+                die_usage(argv[0]);
+            }
+        }
+        if (binary) {
+            if (type_set && type != format_type) die_usage(argv[0]);             // conflicting types
+            if (!path || strcmp(path, "-") == 0) die_usage(argv[0]);             // binary input is mapped
+            type = format_type;
+        }
+        return run_stream(path, type, binary, max_distinct, threads, summary_path);
     }
 
-    // Parse inputs strictly as integers.
-    for (size_t i = 0; i < n; ++i) {
-        int v;
-        if (!parse_int_strict(argv[i + 1], &v)) {
-            fprintf(stderr, "Invalid integer: '%s'\n", argv[i + 1]);
-            free(a);
-            return EXIT_FAILURE;
+    // Merge mode: combine summaries written by --save-summary (e.g. one per shard).
+    if (strcmp(argv[1], "--merge") == 0) {
+        size_t max_distinct = (size_t)1 << 24;
+        const char *summary_path = NULL;
+        char **paths = (char **)malloc((size_t)argc * sizeof(char *));
+        if (!paths) { perror("malloc"); return EXIT_FAILURE; }
+        int count = 0;
+        for (int i = 2; i < argc; ++i) {
+            if (strcmp(argv[i], "--max-distinct") == 0 && i + 1 < argc) {
+                char *end = NULL;
+                max_distinct = (size_t)strtoull(argv[++i], &end, 10);
+                if (*end != '\0' || max_distinct == 0) die_usage(argv[0]);
+            } else if (strcmp(argv[i], "--save-summary") == 0 && i + 1 < argc) {
+                summary_path = argv[++i];
+            } else {
+                paths[count++] = argv[i];
+            }
         }
-        a[i] = v;
+        if (count == 0) die_usage(argv[0]);
+        const int rc = run_merge(paths, count, max_distinct, summary_path);
+        free(paths);
+        return rc;
     }
 
-    // Prepare a sorted copy for median/mode.
-    int *sorted = (int *)malloc(n * sizeof(int));
-    int *modes = (int *)malloc(n * sizeof(int));
-    if (!sorted || !modes) {
-        perror("malloc");
-        free(a);
-        free(sorted);
-        free(modes);
-        return EXIT_FAILURE;
+    // Leading --type and --sort (radix sort a copy and read median/mode off it, the classic path).
+    value_type type = TYPE_I32;
+    int use_sort = 0, first = 1;
+    for (;;) {
+        if (first < argc && strcmp(argv[first], "--sort") == 0) {
+            use_sort = 1;
+            ++first;
+        } else if (first + 1 < argc && strcmp(argv[first], "--type") == 0) {
+            if (!parse_type(argv[first + 1], &type)) die_usage(argv[0]);
+            first += 2;
+        } else {
+            break;
+        }
     }
-    memcpy(sorted, a, n * sizeof(int));
-    qsort(sorted, n, sizeof(int), cmp_int);
-
-    // Compute stats.
-    const double m = mean(a, n);
-    const double med = median_sorted(sorted, n);
-    int maxfreq = 0;
-    const size_t modes_count = modes_from_sorted(sorted, n, modes, &maxfreq);
-
-    // Print results.
-    printf("Count : %zu\n", n);
-    printf("Mean  : %.6f\n", m);
-    printf("Median: %.6f\n", med);
-    printf("Mode  : ");
-    for (size_t i = 0; i < modes_count; ++i) {
-        printf("%d%s", modes[i], (i + 1 < modes_count ? " " : ""));
+    if (argc - first <= 0) {
+        die_usage(argv[0]);
     }
-    printf(" (frequency=%d)\n", maxfreq);
 
-    free(a);
-    free(sorted);
-    free(modes);
-    return EXIT_SUCCESS;
+    const size_t n = (size_t)(argc - first);
+    switch (type) {
+    case TYPE_I64: return run_args_i64(argv + first, n, use_sort);
+    case TYPE_F64: return run_args_f64(argv + first, n, use_sort);
+    default: return run_args_i32(argv + first, n, use_sort);
+    }
 }
+#endif
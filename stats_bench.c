@@ -0,0 +1,380 @@
+/*
+  Fixed-seed benchmark for stats.c: ns per value for each hot path.
+
+  Build: make stats_bench
+  Usage: stats_bench [--n 1000000] [--distinct 4096] [--skew 1.1] [common bench_harness.h options]
+    n        : values per dataset
+    distinct : distinct values in the Zipf-distributed (mode-heavy) dataset
+    skew     : Zipf exponent of that dataset
+
+  Datasets: uniform int32 in [-10^6, 10^6], Zipf int32, lognormal int64
+  latencies around 250us in ns, uniform doubles in [-10^3, 10^3], and uniform
+  doubles in [10^307, DBL_MAX] (their sum overflows unless it is rescaled).
+*/
+#define STATS_NO_MAIN
+#include "stats.c"
+
+#include "bench_harness.h"
+
+#include <float.h>
+
+#define STREAM_MAX_DISTINCT ((size_t)1 << 24)
+
+/* ---------- Datasets ---------- */
+
+typedef struct {
+    char *text;            /* values separated by '\n', NUL-terminated */
+    char *strings;         /* the same bytes with every separator set to '\0' */
+    size_t *offsets;       /* token starts */
+    size_t *lens;
+    size_t len, count;
+} text_data;
+
+static int text_init(text_data *t, const void *values, value_type type, size_t n) {
+    memset(t, 0, sizeof *t);
+    t->text = (char *)malloc(n * 24 + 1);
+    t->offsets = (size_t *)malloc(n * sizeof(size_t));
+    t->lens = (size_t *)malloc(n * sizeof(size_t));
+    if (!t->text || !t->offsets || !t->lens) return 0;
+    for (size_t i = 0; i < n; ++i) {
+        const long long v = type == TYPE_I32 ? ((const int *)values)[i] : (long long)((const int64_t *)values)[i];
+        t->offsets[i] = t->len;
+        t->lens[i] = (size_t)sprintf(t->text + t->len, "%lld", v);
+        t->len += t->lens[i];
+        t->text[t->len++] = '\n';
+    }
+    t->text[t->len] = '\0';
+    t->count = n;
+    if (!(t->strings = (char *)malloc(t->len + 1))) return 0;
+    memcpy(t->strings, t->text, t->len + 1);
+    for (size_t i = 0; i < n; ++i) t->strings[t->offsets[i] + t->lens[i]] = '\0';
+    return 1;
+}
+
+static void text_free(text_data *t) {
+    free(t->text);
+    free(t->strings);
+    free(t->offsets);
+    free(t->lens);
+}
+
+typedef struct {
+    size_t n;
+    int *uniform, *zipf, *i32_work, *i32_out;
+    int64_t *latency, *i64_work, *i64_out;
+    double *doubles, *huge, *f64_work, *f64_out;
+    text_data uniform_text, latency_text;
+    stream_stats st;       /* state for the stream and summary benchmarks */
+    int st_live;
+    summary_buf summary;
+} bench_data;
+
+static int data_init(bench_data *d, size_t n, size_t distinct, double skew, uint64_t seed) {
+    memset(d, 0, sizeof *d);
+    d->n = n;
+    d->uniform = (int *)malloc(n * sizeof(int));
+    d->zipf = (int *)malloc(n * sizeof(int));
+    d->i32_work = (int *)malloc(n * sizeof(int));
+    d->i32_out = (int *)malloc(n * sizeof(int));
+    d->latency = (int64_t *)malloc(n * sizeof(int64_t));
+    d->i64_work = (int64_t *)malloc(n * sizeof(int64_t));
+    d->i64_out = (int64_t *)malloc(n * sizeof(int64_t));
+    d->doubles = (double *)malloc(n * sizeof(double));
+    d->huge = (double *)malloc(n * sizeof(double));
+    d->f64_work = (double *)malloc(n * sizeof(double));
+    d->f64_out = (double *)malloc(n * sizeof(double));
+    if (!d->uniform || !d->zipf || !d->i32_work || !d->i32_out || !d->latency || !d->i64_work ||
+        !d->i64_out || !d->doubles || !d->huge || !d->f64_work || !d->f64_out) {
+        return 0;
+    }
+    // Distinct seeds per dataset, so changing one generator leaves the others alone.
+    bench_gen_uniform_i32(d->uniform, n, -1000000, 1000000, seed);
+    if (!bench_gen_zipf_i32(d->zipf, n, distinct, skew, seed + 1)) return 0;
+    bench_gen_lognormal_i64(d->latency, n, 250000.0, 1.0, seed + 2);
+    bench_gen_uniform_f64(d->doubles, n, -1000.0, 1000.0, seed + 3);
+    bench_gen_uniform_f64(d->huge, n, 1e307, DBL_MAX, seed + 4);
+    return text_init(&d->uniform_text, d->uniform, TYPE_I32, n) &&
+           text_init(&d->latency_text, d->latency, TYPE_I64, n);
+}
+
+static void data_free(bench_data *d) {
+    free(d->uniform);
+    free(d->zipf);
+    free(d->i32_work);
+    free(d->i32_out);
+    free(d->latency);
+    free(d->i64_work);
+    free(d->i64_out);
+    free(d->doubles);
+    free(d->huge);
+    free(d->f64_work);
+    free(d->f64_out);
+    text_free(&d->uniform_text);
+    text_free(&d->latency_text);
+    if (d->st_live) stream_free(&d->st);
+    free(d->summary.p);
+}
+
+/* ---------- Bodies ---------- */
+
+// Bodies take the bench_data as ctx. A failed call aborts: timing a failed run means nothing.
+
+static void check(int ok, const char *what) {
+    if (ok) return;
+    fprintf(stderr, "stats_bench: %s failed\n", what);
+    exit(EXIT_FAILURE);
+}
+
+static void parse_fast_i32(void *ctx) {
+    const bench_data *d = (const bench_data *)ctx;
+    const text_data *t = &d->uniform_text;
+    long long sum = 0;
+    for (size_t i = 0; i < t->count; ++i) {
+        int v;
+        check(parse_int_fast(t->text + t->offsets[i], t->lens[i], &v), "parse_int_fast");
+        sum += v;
+    }
+    bench_consume((double)sum);
+}
+
+static void parse_strict_i32(void *ctx) {
+    const bench_data *d = (const bench_data *)ctx;
+    const text_data *t = &d->uniform_text;
+    long long sum = 0;
+    for (size_t i = 0; i < t->count; ++i) {
+        int v;
+        check(parse_int_strict(t->strings + t->offsets[i], &v), "parse_int_strict");
+        sum += v;
+    }
+    bench_consume((double)sum);
+}
+
+static void parse_fast_i64(void *ctx) {
+    const bench_data *d = (const bench_data *)ctx;
+    const text_data *t = &d->latency_text;
+    int64_t sum = 0;
+    for (size_t i = 0; i < t->count; ++i) {
+        int64_t v;
+        check(parse_int64_fast(t->text + t->offsets[i], t->lens[i], &v), "parse_int64_fast");
+        sum += v;
+    }
+    bench_consume((double)sum);
+}
+
+static void parse_strict_i64(void *ctx) {
+    const bench_data *d = (const bench_data *)ctx;
+    const text_data *t = &d->latency_text;
+    int64_t sum = 0;
+    for (size_t i = 0; i < t->count; ++i) {
+        int64_t v;
+        check(parse_int64_strict(t->strings + t->offsets[i], &v), "parse_int64_strict");
+        sum += v;
+    }
+    bench_consume((double)sum);
+}
+
+static void sum_uniform_i32(void *ctx) {
+    const bench_data *d = (const bench_data *)ctx;
+    bench_consume((double)sum_i32(d->uniform, d->n));
+}
+
+static void minmax_uniform_i32(void *ctx) {
+    const bench_data *d = (const bench_data *)ctx;
+    int lo, hi;
+    minmax_i32(d->uniform, d->n, &lo, &hi);
+    bench_consume((double)lo + hi);
+}
+
+static void mean_doubles(void *ctx) {
+    const bench_data *d = (const bench_data *)ctx;
+    bench_consume(mean_f64(d->doubles, d->n));
+}
+
+static void mean_huge_doubles(void *ctx) {
+    const bench_data *d = (const bench_data *)ctx;
+    const double mean = mean_f64(d->huge, d->n);
+    check(isfinite(mean) && mean >= 1e307 && mean <= DBL_MAX, "mean_f64 near DBL_MAX");
+    bench_consume(mean);
+}
+
+// Selection and sorting work in place, so setup restores the input each run.
+static void copy_uniform(void *ctx) {
+    bench_data *d = (bench_data *)ctx;
+    memcpy(d->i32_work, d->uniform, d->n * sizeof(int));
+}
+
+static void copy_latency(void *ctx) {
+    bench_data *d = (bench_data *)ctx;
+    memcpy(d->i64_work, d->latency, d->n * sizeof(int64_t));
+}
+
+static void copy_doubles(void *ctx) {
+    bench_data *d = (bench_data *)ctx;
+    memcpy(d->f64_work, d->doubles, d->n * sizeof(double));
+}
+
+static void median_select_uniform_i32(void *ctx) {
+    bench_data *d = (bench_data *)ctx;
+    double med;
+    check(median_select_i32(d->i32_work, d->n, &med), "median_select_i32");
+    bench_consume(med);
+}
+
+static void median_radix_uniform_i32(void *ctx) {
+    bench_data *d = (bench_data *)ctx;
+    radix_sort_i32(d->i32_work, d->i32_out, d->n);
+    bench_consume(median_sorted_i32(d->i32_work, d->n));
+}
+
+static void median_select_latency_i64(void *ctx) {
+    bench_data *d = (bench_data *)ctx;
+    double med;
+    check(median_select_i64(d->i64_work, d->n, &med), "median_select_i64");
+    bench_consume(med);
+}
+
+static void median_select_doubles(void *ctx) {
+    bench_data *d = (bench_data *)ctx;
+    double med;
+    check(median_select_f64(d->f64_work, d->n, &med), "median_select_f64");
+    bench_consume(med);
+}
+
+static void mode_uniform_i32(void *ctx) {
+    bench_data *d = (bench_data *)ctx;
+    size_t maxfreq = 0;
+    check(modes_counted_i32(d->uniform, d->n, d->i32_out, &maxfreq) != (size_t)-1, "modes_counted_i32");
+    bench_consume((double)maxfreq);
+}
+
+static void mode_zipf_i32(void *ctx) {
+    bench_data *d = (bench_data *)ctx;
+    size_t maxfreq = 0;
+    check(modes_counted_i32(d->zipf, d->n, d->i32_out, &maxfreq) != (size_t)-1, "modes_counted_i32");
+    bench_consume((double)maxfreq);
+}
+
+static void mode_latency_i64(void *ctx) {
+    bench_data *d = (bench_data *)ctx;
+    size_t maxfreq = 0;
+    check(modes_counted_i64(d->latency, d->n, d->i64_out, &maxfreq) != (size_t)-1, "modes_counted_i64");
+    bench_consume((double)maxfreq);
+}
+
+static void reset_stream_i32(void *ctx) {
+    bench_data *d = (bench_data *)ctx;
+    if (d->st_live) stream_free(&d->st);
+    d->st_live = stream_init(&d->st, STREAM_MAX_DISTINCT, TYPE_I32);
+    check(d->st_live, "stream_init");
+}
+
+static void reset_stream_i64(void *ctx) {
+    bench_data *d = (bench_data *)ctx;
+    if (d->st_live) stream_free(&d->st);
+    d->st_live = stream_init(&d->st, STREAM_MAX_DISTINCT, TYPE_I64);
+    check(d->st_live, "stream_init");
+}
+
+static void stream_text_i32(void *ctx) {
+    bench_data *d = (bench_data *)ctx;
+    const char *bad = NULL;
+    size_t bad_len = 0;
+    const text_data *t = &d->uniform_text;
+    check(stream_parse_i32(&d->st, t->text, t->text + t->len, &bad, &bad_len) && !bad, "stream_parse_i32");
+}
+
+static void stream_binary_latency_i64(void *ctx) {
+    bench_data *d = (bench_data *)ctx;
+    const char *p = (const char *)d->latency, *bad = NULL;
+    check(stream_binary_i64(&d->st, p, p + d->n * sizeof(int64_t), &bad) && !bad, "stream_binary_i64");
+}
+
+// The summary benchmarks share one exact state built from the Zipf data.
+static void summary_encode_zipf(void *ctx) {
+    bench_data *d = (bench_data *)ctx;
+    d->summary.len = 0;
+    check(summary_encode(&d->st, &d->summary), "summary_encode");
+}
+
+static void summary_merge_zipf(void *ctx) {
+    bench_data *d = (bench_data *)ctx;
+    stream_stats dst;
+    check(stream_init(&dst, STREAM_MAX_DISTINCT, TYPE_I32), "stream_init");
+    check(summary_merge(&dst, d->summary.p, d->summary.len) == SUMMARY_OK, "summary_merge");
+    bench_consume((double)dst.n);
+    stream_free(&dst);
+}
+
+/* ---------- Driver ---------- */
+
+int main(int argc, char **argv) {
+    size_t n = 1000000, distinct = 4096;
+    double skew = 1.1;
+    bench_session session;
+    bench_session_init(&session, "stats");
+    for (int i = 1; i < argc; ++i) {
+        const int common = bench_session_option(&session, argc, argv, &i);
+        if (common > 0) continue;
+        const int valued = common == 0 && i + 1 < argc;
+        if (valued && strcmp(argv[i], "--n") == 0) n = (size_t)strtoull(argv[++i], NULL, 10);
+        else if (valued && strcmp(argv[i], "--distinct") == 0) distinct = (size_t)strtoull(argv[++i], NULL, 10);
+        else if (valued && strcmp(argv[i], "--skew") == 0) skew = atof(argv[++i]);
+        else {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (n == 0 || distinct == 0) {
+        fprintf(stderr, "--n and --distinct must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    bench_data d;
+    if (!data_init(&d, n, distinct, skew, session.seed)) {
+        perror("malloc");
+        data_free(&d);
+        return EXIT_FAILURE;
+    }
+    if (session.table) printf("n=%zu distinct=%zu skew=%.2f\n", n, distinct, skew);
+    if (!bench_session_start(&session)) {
+        data_free(&d);
+        return EXIT_FAILURE;
+    }
+
+    const struct {
+        const char *name;
+        bench_fn setup, body;
+    } cases[] = {
+        {"parse.fast_i32", NULL, parse_fast_i32},
+        {"parse.strict_i32", NULL, parse_strict_i32},
+        {"parse.fast_i64", NULL, parse_fast_i64},
+        {"parse.strict_i64", NULL, parse_strict_i64},
+        {"sum.i32", NULL, sum_uniform_i32},
+        {"minmax.i32", NULL, minmax_uniform_i32},
+        {"mean.f64", NULL, mean_doubles},
+        {"mean.f64_huge", NULL, mean_huge_doubles},
+        {"median.select_i32", copy_uniform, median_select_uniform_i32},
+        {"median.radix_i32", copy_uniform, median_radix_uniform_i32},
+        {"median.select_i64", copy_latency, median_select_latency_i64},
+        {"median.select_f64", copy_doubles, median_select_doubles},
+        {"mode.uniform_i32", NULL, mode_uniform_i32},
+        {"mode.zipf_i32", NULL, mode_zipf_i32},
+        {"mode.latency_i64", NULL, mode_latency_i64},
+        {"stream.text_i32", reset_stream_i32, stream_text_i32},
+        {"stream.binary_i64", reset_stream_i64, stream_binary_latency_i64},
+    };
+    for (size_t c = 0; c < sizeof cases / sizeof cases[0]; ++c) {
+        const bench_result r = bench_run(&session.cfg, n, cases[c].setup, cases[c].body, &d);
+        bench_record(&session, cases[c].name, n, &r);
+    }
+
+    reset_stream_i32(&d);
+    check(stream_add_batch_i32(&d.st, d.zipf, n), "stream_add_batch_i32");
+    bench_result r = bench_run(&session.cfg, n, NULL, summary_encode_zipf, &d);
+    bench_record(&session, "summary.encode_zipf", n, &r);
+    r = bench_run(&session.cfg, n, NULL, summary_merge_zipf, &d);
+    bench_record(&session, "summary.merge_zipf", n, &r);
+
+    data_free(&d);
+    return bench_session_finish(&session);
+}
@@ -0,0 +1,375 @@
+/*
+  Type-generic kernels for stats.c. This header is a code generator, not a
+  normal header: it has no include guard and is included once per element
+  type, with these macros defined by the includer (and undefined here after
+  each expansion):
+
+    STATS_T              element type (int, int64_t, double)
+    STATS_NAME(x)        x with the type's suffix, e.g. x##_i32
+    STATS_TYPE           the matching value_type tag
+    STATS_INTEGRAL       1 for integer types (enables the direct histogram)
+    STATS_UKEY           unsigned type as wide as STATS_T, for the radix sort
+    STATS_RADIX_KEY(v)   STATS_T -> STATS_UKEY, order-preserving
+    STATS_KEY(v)         STATS_T -> int64_t order-preserving key (streaming state)
+    STATS_FROM_KEY(k)    inverse of STATS_KEY
+    STATS_MIDPOINT(a, b) (a + b) / 2 as a double, without overflow
+    STATS_PARSE_ARG(s, out)        strict parse of a NUL-terminated argument
+    STATS_PARSE_TOKEN(s, len, out) strict parse of a whitespace-free token
+    STATS_VALID(v)       whether a binary record holds an acceptable value
+    STATS_LOAD(p)        little-endian record at p -> STATS_T
+    STATS_PRINT(v)       prints one value to stdout
+
+  and with STATS_NAME(sum_into) and STATS_NAME(minmax) already defined, so SIMD
+  reductions can be written per type. Generated here: mean, sorted and
+  selection-based median, modes (sorted, histogram and hashed), the streaming
+  batch/parse/binary readers, and the argv driver run_args_<suffix>().
+*/
+
+#ifndef STATS_T
+#error "define STATS_T and the other STATS_* parameters before including stats_kernels.h"
+#endif
+
+/* ---------- Core statistics ---------- */
+
+static double STATS_NAME(mean)(const STATS_T *a, size_t n) {
+    stats_sum s = STATS_SUM_ZERO;
+    STATS_NAME(sum_into)(&s, a, n);   // exact for integers, compensated for doubles
+    return stats_sum_mean(&s, n);
+}
+
+/* Assumes 'sorted' is sorted ascending. */
+static double STATS_NAME(median_sorted)(const STATS_T *sorted, size_t n) {
+    if (n % 2 == 1) {
+        return (double)sorted[n / 2];
+    } else {
+        return STATS_MIDPOINT(sorted[n / 2 - 1], sorted[n / 2]);
+    }
+}
+
+/*
+  Compute modes from a sorted array.
+  - 'modes_out' must have capacity at least n.
+  - Returns the number of modes, and writes max frequency to *maxfreq_out.
+*/
+static size_t STATS_NAME(modes_from_sorted)(const STATS_T *sorted, size_t n,
+                                            STATS_T *modes_out, size_t *maxfreq_out) {
+    if (n == 0) { *maxfreq_out = 0; return 0; }
+
+    size_t maxf = 0;
+    size_t modes_count = 0;
+
+    size_t i = 0;
+    while (i < n) {
+        const STATS_T value = sorted[i];
+        size_t count = 1;
+        while (i + count < n && sorted[i + count] == value) ++count;
+
+        if (count > maxf) {
+            maxf = count;
+            modes_out[0] = value;
+            modes_count = 1;
+        } else if (count == maxf) {
+            modes_out[modes_count++] = value;
+        }
+
+        i += count;
+    }
+
+    *maxfreq_out = maxf;
+    return modes_count;
+}
+
+/* ---------- Sorting and selection ---------- */
+
+/*
+  LSD radix sort, 8 bits per pass, on the order-preserving STATS_RADIX_KEY.
+  A pass whose byte is the same for every key is skipped. 'tmp' must hold n
+  elements.
+*/
+static void STATS_NAME(radix_sort)(STATS_T *a, STATS_T *tmp, size_t n) {
+    if (n < 2) return;
+    STATS_T *src = a, *dst = tmp;
+    for (unsigned shift = 0; shift < 8 * sizeof(STATS_UKEY); shift += 8) {
+        size_t count[256] = {0};
+        for (size_t i = 0; i < n; ++i) ++count[(STATS_RADIX_KEY(src[i]) >> shift) & 0xFF];
+        if (count[(STATS_RADIX_KEY(src[0]) >> shift) & 0xFF] == n) continue;
+        size_t pos = 0;
+        for (size_t b = 0; b < 256; ++b) { const size_t c = count[b]; count[b] = pos; pos += c; }
+        for (size_t i = 0; i < n; ++i) dst[count[(STATS_RADIX_KEY(src[i]) >> shift) & 0xFF]++] = src[i];
+        STATS_T *t = src; src = dst; dst = t;
+    }
+    if (src != a) memcpy(a, src, n * sizeof(STATS_T));
+}
+
+static void STATS_NAME(swap)(STATS_T *x, STATS_T *y) { const STATS_T t = *x; *x = *y; *y = t; }
+
+/*
+  Introselect: rearranges a[0..n) so a[k] is the k-th smallest, everything
+  before it <= a[k] and everything after >= a[k]. Quickselect with a
+  median-of-three pivot and three-way partition; after 2*log2(n) rounds
+  without converging, the remaining range is radix sorted instead, which
+  bounds the worst case at O(n). Returns 0 only if that fallback cannot
+  allocate.
+*/
+static int STATS_NAME(select_kth)(STATS_T *a, size_t n, size_t k) {
+    size_t lo = 0, hi = n;          /* k is inside [lo, hi) */
+    size_t budget = 2;
+    for (size_t m = n; m > 1; m >>= 1) budget += 2;
+    while (hi - lo > 16) {
+        if (budget-- == 0) {
+            STATS_T *tmp = (STATS_T *)malloc((hi - lo) * sizeof(STATS_T));
+            if (!tmp) return 0;
+            STATS_NAME(radix_sort)(a + lo, tmp, hi - lo);
+            free(tmp);
+            return 1;
+        }
+        const size_t mid = lo + (hi - lo) / 2;
+        if (a[mid] < a[lo]) STATS_NAME(swap)(&a[mid], &a[lo]);
+        if (a[hi - 1] < a[lo]) STATS_NAME(swap)(&a[hi - 1], &a[lo]);
+        if (a[hi - 1] < a[mid]) STATS_NAME(swap)(&a[hi - 1], &a[mid]);
+        const STATS_T pivot = a[mid];
+        /* [lo, lt) < pivot, [lt, i) == pivot, (gt, hi) > pivot */
+        size_t lt = lo, i = lo, gt = hi;
+        while (i < gt) {
+            if (a[i] < pivot) STATS_NAME(swap)(&a[lt++], &a[i++]);
+            else if (a[i] > pivot) STATS_NAME(swap)(&a[i], &a[--gt]);
+            else ++i;
+        }
+        if (k < lt) hi = lt;
+        else if (k >= gt) lo = gt;
+        else return 1;
+    }
+    for (size_t i = lo + 1; i < hi; ++i) {            /* insertion sort the last few */
+        const STATS_T v = a[i];
+        size_t j = i;
+        while (j > lo && a[j - 1] > v) { a[j] = a[j - 1]; --j; }
+        a[j] = v;
+    }
+    return 1;
+}
+
+/* Median without a full sort; reorders 'a'. Same result as median_sorted(). */
+static int STATS_NAME(median_select)(STATS_T *a, size_t n, double *out) {
+    const size_t k = n / 2;
+    if (!STATS_NAME(select_kth)(a, n, k)) return 0;
+    if (n % 2 == 1) {
+        *out = (double)a[k];
+        return 1;
+    }
+    STATS_T left = a[0];                              /* largest of the lower half */
+    for (size_t i = 1; i < k; ++i) if (a[i] > left) left = a[i];
+    *out = STATS_MIDPOINT(left, a[k]);
+    return 1;
+}
+
+#if STATS_INTEGRAL
+/*
+  Mode(s) from a direct histogram over [min, max]. Output as
+  modes_from_sorted(): all values at the highest frequency, ascending.
+  Returns (size_t)-1 if the histogram cannot be allocated.
+*/
+static size_t STATS_NAME(modes_histogram)(const STATS_T *a, size_t n, STATS_T min, size_t range,
+                                          STATS_T *modes_out, size_t *maxfreq_out) {
+    size_t *hist = (size_t *)calloc(range, sizeof(size_t));
+    if (!hist) return (size_t)-1;
+    for (size_t i = 0; i < n; ++i) ++hist[(size_t)((uint64_t)a[i] - (uint64_t)min)];
+    size_t maxf = 0, modes_count = 0;
+    for (size_t v = 0; v < range; ++v) {
+        if (hist[v] > maxf) { maxf = hist[v]; modes_count = 0; }
+        if (hist[v] == maxf && maxf) modes_out[modes_count++] = (STATS_T)((uint64_t)min + v);
+    }
+    free(hist);
+    *maxfreq_out = maxf;
+    return modes_count;
+}
+#endif
+
+/*
+  Mode(s) of a[0..n): a direct histogram when max - min is small (integers
+  only), otherwise a count table over the value keys. Same output as
+  modes_from_sorted(), without sorting the input. Returns (size_t)-1 on
+  allocation failure.
+*/
+static size_t STATS_NAME(modes_counted)(const STATS_T *a, size_t n, STATS_T *modes_out, size_t *maxfreq_out) {
+    *maxfreq_out = 0;
+    if (n == 0) return 0;
+#if STATS_INTEGRAL
+    STATS_T min, max;
+    STATS_NAME(minmax)(a, n, &min, &max);
+    const uint64_t span = (uint64_t)max - (uint64_t)min;   // range - 1; cannot overflow
+    if (span < HISTOGRAM_MAX_RANGE && span < 4 * (uint64_t)n + 1024) {
+        return STATS_NAME(modes_histogram)(a, n, min, (size_t)span + 1, modes_out, maxfreq_out);
+    }
+#endif
+
+    count_table t;
+    if (!count_table_init(&t, SIZE_MAX)) { count_table_free(&t); return (size_t)-1; }
+    for (size_t i = 0; i < n; ++i) {
+        if (!count_table_add(&t, STATS_KEY(a[i]), 1)) { count_table_free(&t); return (size_t)-1; }
+    }
+    size_t maxf = 0, modes_count = 0;
+    for (size_t i = 0; i < t.cap; ++i) if (t.counts[i] > maxf) maxf = t.counts[i];
+    for (size_t i = 0; i < t.cap; ++i) if (t.counts[i] == maxf) modes_out[modes_count++] = STATS_FROM_KEY(t.keys[i]);
+    count_table_free(&t);
+
+    STATS_T *tmp = (STATS_T *)malloc((modes_count ? modes_count : 1) * sizeof(STATS_T));
+    if (!tmp) return (size_t)-1;
+    STATS_NAME(radix_sort)(modes_out, tmp, modes_count);
+    free(tmp);
+    *maxfreq_out = maxf;
+    return modes_count;
+}
+
+/* ---------- Streaming ---------- */
+
+static int STATS_NAME(stream_add_batch)(stream_stats *st, const STATS_T *v, size_t k) {
+    if (k == 0) return 1;
+    STATS_T min, max;
+    STATS_NAME(minmax)(v, k, &min, &max);
+    stream_extend_range(st, k, STATS_KEY(min), STATS_KEY(max));
+    STATS_NAME(sum_into)(&st->sum, v, k);
+    for (size_t i = 0; i < k; ++i) {
+        if (!stream_count(st, STATS_KEY(v[i]), 1)) return 0;
+    }
+    return 1;
+}
+
+/*
+  Parses every token in [p, end) into 'st' in STREAM_BATCH blocks. On a bad
+  token returns 0 with *bad and *bad_len set to it; on allocation failure returns
+  0 with *bad = NULL.
+*/
+static int STATS_NAME(stream_parse)(stream_stats *st, const char *p, const char *end,
+                                    const char **bad, size_t *bad_len) {
+    STATS_T batch[STREAM_BATCH];
+    size_t k = 0;
+    *bad = NULL;
+    while (p < end) {
+        while (p < end && is_space(*p)) ++p;
+        const char *start = p;
+        while (p < end && !is_space(*p)) ++p;
+        if (p == start) break;
+        const size_t len = (size_t)(p - start);
+        if (len > MAX_TOKEN || !STATS_PARSE_TOKEN(start, len, &batch[k])) {
+            *bad = start;
+            *bad_len = len;
+            return 0;
+        }
+        if (++k == STREAM_BATCH) {
+            if (!STATS_NAME(stream_add_batch)(st, batch, k)) return 0;
+            k = 0;
+        }
+    }
+    return STATS_NAME(stream_add_batch)(st, batch, k);
+}
+
+/*
+  Raw little-endian records in [p, end). On little-endian hosts blocks are
+  reduced straight out of the (page-aligned) mapping; elsewhere they are
+  byte-swapped into a batch. On a record STATS_VALID() rejects, returns 0
+  with *bad pointing at it; on allocation failure *bad = NULL.
+*/
+static int STATS_NAME(stream_binary)(stream_stats *st, const char *p, const char *end, const char **bad) {
+    *bad = NULL;
+    while (p < end) {
+        size_t k = (size_t)(end - p) / sizeof(STATS_T);
+        if (k > STREAM_BATCH) k = STREAM_BATCH;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        STATS_T batch[STREAM_BATCH];
+        for (size_t i = 0; i < k; ++i) batch[i] = STATS_LOAD(p + i * sizeof(STATS_T));
+        const STATS_T *block = batch;
+#else
+        const STATS_T *block = (const STATS_T *)(const void *)p;
+#endif
+        for (size_t i = 0; i < k; ++i) {
+            if (!STATS_VALID(block[i])) { *bad = p + i * sizeof(STATS_T); return 0; }
+        }
+        if (!STATS_NAME(stream_add_batch)(st, block, k)) return 0;
+        p += k * sizeof(STATS_T);
+    }
+    return 1;
+}
+
+/* ---------- Argument driver ---------- */
+
+/* Stats over n argument strings; --sort selects the radix sort path. */
+STATS_MAIN_ONLY static int STATS_NAME(run_args)(char **args, size_t n, int use_sort) {
+    STATS_T *a = (STATS_T *)malloc(n * sizeof(STATS_T));
+    if (!a) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+
+    // Parse inputs strictly.
+    for (size_t i = 0; i < n; ++i) {
+        if (!STATS_PARSE_ARG(args[i], &a[i])) {
+            fprintf(stderr, "Invalid %s: '%s'\n", value_type_noun(STATS_TYPE), args[i]);
+            free(a);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Scratch copy for median selection (or sorting); modes needs at most n slots.
+    STATS_T *work = (STATS_T *)malloc(n * sizeof(STATS_T));
+    STATS_T *modes = (STATS_T *)malloc(n * sizeof(STATS_T));
+    if (!work || !modes) {
+        perror("malloc");
+        free(a);
+        free(work);
+        free(modes);
+        return EXIT_FAILURE;
+    }
+    memcpy(work, a, n * sizeof(STATS_T));
+
+    // Compute stats.
+    const double m = STATS_NAME(mean)(a, n);
+    double med = 0.0;
+    size_t maxfreq = 0;
+    size_t modes_count;
+    if (use_sort) {
+        STATS_NAME(radix_sort)(work, modes, n);   // 'modes' doubles as the radix buffer
+        med = STATS_NAME(median_sorted)(work, n);
+        modes_count = STATS_NAME(modes_from_sorted)(work, n, modes, &maxfreq);
+    } else {
+        modes_count = STATS_NAME(median_select)(work, n, &med)
+                          ? STATS_NAME(modes_counted)(a, n, modes, &maxfreq) : (size_t)-1;
+    }
+    if (modes_count == (size_t)-1) {
+        perror("malloc");
+        free(a);
+        free(work);
+        free(modes);
+        return EXIT_FAILURE;
+    }
+
+    // Print results.
+    printf("Count : %zu\n", n);
+    printf("Mean  : %.6f\n", m);
+    printf("Median: %.6f\n", med);
+    printf("Mode  : ");
+    for (size_t i = 0; i < modes_count; ++i) {
+        STATS_PRINT(modes[i]);
+        if (i + 1 < modes_count) putchar(' ');
+    }
+    printf(" (frequency=%zu)\n", maxfreq);
+
+    free(a);
+    free(work);
+    free(modes);
+    return EXIT_SUCCESS;
+}
+
+#undef STATS_T
+#undef STATS_NAME
+#undef STATS_TYPE
+#undef STATS_INTEGRAL
+#undef STATS_UKEY
+#undef STATS_RADIX_KEY
+#undef STATS_KEY
+#undef STATS_FROM_KEY
+#undef STATS_MIDPOINT
+#undef STATS_PARSE_ARG
+#undef STATS_PARSE_TOKEN
+#undef STATS_VALID
+#undef STATS_LOAD
+#undef STATS_PRINT